@@ -1,6 +1,8 @@
+#define ARITHMETIC_ENCODING_C
 #include "inc.h"
 #include "arithmetic-encoding.h"
 #include "safe.h"
+#include "intmath.h"
 
 /******************************************************/
 /* Conventional computer media are organized by bits, */
@@ -116,6 +118,12 @@ struct Arith {
     u08* out_ptr;           /* Where to write next output byte. */
     u32  queued_byte;
     u32  queued_ff_bytes;   /* Used by encoder only.: */
+
+    /* The range coder's state;  see below: */
+    bool range_coder;
+    u64  low;               /* Encoder only, with a carry in bit 32. */
+    u32  range;
+    u32  code;              /* Decoder only:  Offset of input from low. */
 };
 
 
@@ -133,9 +141,13 @@ struct Arith {
 
 #define TAIL_EXTRA_BITS	(8 - EXTRA_BITS)     /* == 1 */
 
-Arith* arith_Create( void          ) {   return new( Arith );      }
+static void range_init( void );
+
+Arith* arith_Create( void          ) {   range_init();   return new( Arith );      }
 void   arith_Destroy( Arith* arith ) {   if (arith) free(arith);   }
 
+void   arith_Use_Range_Coder( Arith* arith,   bool range_coder ) {   arith->range_coder = range_coder;   }
+
 static void flush_output_queue(   Arith* arith,   u08 carry   ) {
 
     /* Send the queued non-0xFF byte, first adding any carry to it: */
@@ -192,9 +204,185 @@ static Free renormalize_and_read_if_needed(   Arith* arith   ) {
 }
 
 
+/*********************************************************/
+/*                 The Range Coder                       */
+/*                                                       */
+/* arith_Use_Range_Coder() swaps the above for a coder   */
+/* which keeps 'low' in 64 bits and 'range' in 32, after */
+/* Subbotin and LZMA.  A carry out of the 32-bit code    */
+/* word lands in bit 32 of 'low', and shift_low() sends  */
+/* it through the same queued_byte / queued_ff_bytes     */
+/* queue as above.  'range' never drops below 2^24, and  */
+/* totals may run to RANGE_TOTAL_MAX, four times what    */
+/* the classic coder allows.                             */
+/*                                                       */
+/* We need range / total on every call, but only need    */
+/* it to agree between coder and decoder and not exceed  */
+/* the true quotient:  The scaled reciprocal below is    */
+/* never more than two under it, which at range >= 2^24  */
+/* costs nothing measurable, and saves the divide.  A    */
+/* power-of-two total just shifts.                       */
+/*                                                       */
+/* This changes the bitstream, so it is recorded in the  */
+/* file header (PZIP_OPTION_RANGE_CODER).                */
+/*********************************************************/
+
+#define RANGE_TOP        ((u32)1 << 24)
+#define RANGE_TOTAL_BITS (16)
+#define RANGE_TOTAL_MAX  ((u32)1 << RANGE_TOTAL_BITS)
+
+/* floor( (2^32 - 1) / total ), entry 0 unused: */
+static u32 range_recip_tab[ RANGE_TOTAL_MAX +1 ];
+
+static void range_init( void ) {
+
+    uint i;
+
+    if (range_recip_tab[1])   return;
+
+    for (i = RANGE_TOTAL_MAX +1;   i --> 1;   ) {
+        range_recip_tab[i] = 0xFFFFFFFFU / i;
+    }
+}
+
+static inline u32 range_ratio(   u32 range,   u32 total   ) {
+
+    assert( total >= 1   &&   total <= RANGE_TOTAL_MAX );
+
+    if (ispow2( total ))   return range >> __builtin_ctz( total );
+    return ((u64)range * range_recip_tab[ total ]) >> 32;
+}
+
+static void shift_low(   Arith* arith   ) {
+
+    /* Unless the top byte of 'low' might still take a carry, */
+    /* flush the queue and queue that byte:                    */
+    if ((u32)arith->low < 0xFF000000U   ||   (arith->low >> 32)) {
+        flush_output_queue( arith, arith->low >> 32 );
+        arith->queued_byte = (arith->low >> 24) & 0xFF;
+    } else {
+        ++ arith->queued_ff_bytes;
+    }
+    arith->low = (arith->low & 0x00FFFFFF) << 8;
+}
+
+static inline void range_renormalize_and_write(   Arith* arith   ) {
+    while (arith->range < RANGE_TOP) {
+        shift_low( arith );
+        arith->range <<= 8;
+    }
+}
+
+static inline void range_renormalize_and_read(   Arith* arith   ) {
+    while (arith->range < RANGE_TOP) {
+        arith->code    = (arith->code << 8) | *arith->out_ptr++;
+        arith->range <<= 8;
+    }
+}
+
+static inline void range_encode(   Arith* arith,   u32 low,   u32 high,   u32 total   ) {
+
+    u32 r = range_ratio( arith->range, total );
+
+    arith->low += (u64)r * low;
+
+    /* As above, the top partition takes the round-off: */
+    if (high == total)   arith->range -= r * low;
+    else                 arith->range  = r * (high - low);
+
+    range_renormalize_and_write( arith );
+}
+
+static inline void range_decode(   Arith* arith,   u32 low,   u32 high,   u32 total   ) {
+
+    u32 r = range_ratio( arith->range, total );
+
+    arith->code -= r * low;
+
+    if (high == total)   arith->range -= r * low;
+    else                 arith->range  = r * (high - low);
+
+    range_renormalize_and_read( arith );
+}
+
+static inline void range_encode_bit(   Arith* arith,   u32 mid,   u32 total,   bool bit   ) {
+
+    u32 r = range_ratio( arith->range, total ) * mid;
+
+    if (bit) {   arith->low += r;   arith->range -= r;   }
+    else     {                      arith->range  = r;   }
+
+    range_renormalize_and_write( arith );
+}
+
+static inline bool range_decode_bit(   Arith* arith,   u32 mid,   u32 total   ) {
+
+    u32  r   = range_ratio( arith->range, total ) * mid;
+    bool bit = arith->code >= r;
+
+    if (bit) {   arith->code -= r;   arith->range -= r;   }
+    else     {                       arith->range  = r;   }
+
+    range_renormalize_and_read( arith );
+
+    return bit;
+}
+
+static void range_start_encoding(   Arith* arith,   u08* out_buf   ) {
+
+    /* Our first byte is always zero, and goes */
+    /* to out_buf[-1] like the classic coder's: */
+    arith->out_ptr         = out_buf-1;
+    arith->low             = 0;
+    arith->range           = 0xFFFFFFFFU;
+    arith->queued_byte     = 0;
+    arith->queued_ff_bytes = 0;
+}
+
+static void range_start_decoding(   Arith* arith,   u08* out_buf   ) {
+
+    int i;
+
+    arith->out_ptr = out_buf;
+    arith->range   = 0xFFFFFFFFU;
+    arith->code    = 0;
+    for (i = 4;   i --> 0;   ) {
+        arith->code = (arith->code << 8) | *arith->out_ptr++;
+    }
+}
+
+static u08* range_finish_encoding(   Arith* arith   ) {
+
+    /**************************************************/
+    /* Send just enough of 'low' that whatever bytes  */
+    /* the decoder finds after it, it stays inside    */
+    /* [low, low + range):  One byte will usually do, */
+    /* and since range >= 2^24, two always will.      */
+    /**************************************************/
+
+    int bytes;
+    for (bytes = 1;   bytes < 4;   ++bytes) {
+        u64 mask = 0xFFFFFFFFU >> (8 * bytes);
+        u64 v    = (arith->low + mask) & ~mask;
+        if (v + mask < arith->low + arith->range) {
+            arith->low = v;
+            break;
+        }
+    }
+
+    /* Flush the queue, then one byte of 'low' per call: */
+    for (++bytes;   bytes --> 0;   )   shift_low( arith );
+
+    memset( arith->out_ptr, 0, 6 );
+
+    return arith->out_ptr;
+}
+
 
 void arith_Start_Decoding(   Arith* arith,   u08* out_buf   ) {
 
+    if (arith->range_coder)   { range_start_decoding( arith, out_buf );   return; }
+
     arith->out_ptr = out_buf;
 
     /**  'base' needs to be kept filled with 31 bits ;
@@ -210,6 +398,8 @@ void arith_Start_Decoding(   Arith* arith,   u08* out_buf   ) {
 
 void arith_Start_Encoding(   Arith* arith,   u08* out_buf   ) {
 
+    if (arith->range_coder)   { range_start_encoding( arith, out_buf );   return; }
+
     arith->out_ptr = out_buf-1;
 
     arith->free.base = 0;
@@ -224,6 +414,8 @@ u08* arith_Finish_Encoding( Arith* arith ) {
     uint wide_mask;
     uint wide_msb;
 
+    if (arith->range_coder)   return range_finish_encoding( arith );
+
     /* Set 'base' to the maximum that won't change how it decodes: */
     arith->free.base += arith->free.wide - 1;
 
@@ -295,11 +487,18 @@ u08* arith_Finish_Encoding( Arith* arith ) {
 u32 arith_Get_1_Of_N(   Arith* arith,   u32 total   ) {
     /* Read Arithmetic-Encoding.doc if you find this function mysterious! */
 
-    Free f = renormalize_and_read_if_needed( arith );
+    Free f;
+    u32  ratio;
+    u32  ret;
 
-    u32 ratio = f.wide / total;
+    if (arith->range_coder) {
+        ret = arith->code / range_ratio( arith->range, total );
+        return   ret >= total ? total-1 : ret;
+    }
 
-    u32 ret = f.base / ratio;      assert( total <= CUMULATIVE_PROBABILITY_MAX );
+    f     = renormalize_and_read_if_needed( arith );
+    ratio = f.wide / total;
+    ret   = f.base / ratio;      assert( total <= CUMULATIVE_PROBABILITY_MAX );
 
     arith->free = f;
 
@@ -309,9 +508,13 @@ u32 arith_Get_1_Of_N(   Arith* arith,   u32 total   ) {
 void arith_Decode_1_Of_N(   Arith* arith,   u32 low,   u32 high,   u32 total   ) {
     /* Read Arithmetic-Encoding.doc if you find this function mysterious! */
 
+    u32 ratio;
+    u32 base_decrement;
+
+    if (arith->range_coder)   { range_decode( arith, low, high, total );   return; }
 
-    u32 ratio          = arith->free.wide / total;
-    u32 base_decrement = ratio * low;
+    ratio              = arith->free.wide / total;
+    base_decrement     = ratio * low;
     arith->free.base    -= base_decrement;
 
     assert( low < high   &&   high <= total );
@@ -324,9 +527,13 @@ void arith_Decode_1_Of_N(   Arith* arith,   u32 low,   u32 high,   u32 total   )
 void arith_Encode_Bit(   Arith* arith,   u32 mid,   u32 total,  bool bit   ) {
     /* Read Arithmetic-Encoding.doc if you find this function mysterious! */
 
-    Free f = arith->free;
+    Free f;
+    u32  r;
+
+    if (arith->range_coder)   { range_encode_bit( arith, mid, total, bit );   return; }
 
-    u32 r = (f.wide / total) * mid;
+    f = arith->free;
+    r = (f.wide / total) * mid;
 
     if (bit) {   f.base += r;   f.wide -= r;    }
     else     {                  f.wide  = r;    }
@@ -353,10 +560,15 @@ void arith_Encode_1_Of_N(   Arith* arith,   u32 low,   u32 high,   u32 total   )
     /*  overflowing  the register, so we instead do:       */
     /*******************************************************/
 
-    Free f = arith->free;
+    Free f;
+    u32  ratio;
+    u32  base_increment;
 
-    u32 ratio          = f.wide / total;
-    u32 base_increment = ratio * low;
+    if (arith->range_coder)   { range_encode( arith, low, high, total );   return; }
+
+    f              = arith->free;
+    ratio          = f.wide / total;
+    base_increment = ratio * low;
 
     assert( low < high   &&   high <= total );
     assert( total <= CUMULATIVE_PROBABILITY_MAX );
@@ -385,10 +597,15 @@ bool arith_Decode_Bit(   Arith* arith,   u32 mid,   u32 total   ) {
     /*   Relative to the above, we eliminate one divide:       */
     /***********************************************************/
 
-    Free f = renormalize_and_read_if_needed( arith );
+    Free f;
+    u32  r;
+    bool bit;
+
+    if (arith->range_coder)   return range_decode_bit( arith, mid, total );
 
-    u32 r  = (f.wide / total) * mid;
-    bool bit =  f.base >= r;
+    f   = renormalize_and_read_if_needed( arith );
+    r   = (f.wide / total) * mid;
+    bit = f.base >= r;
 
     if (bit) {    f.base -= r;   f.wide -= r; }
     else     {                   f.wide  = r; }
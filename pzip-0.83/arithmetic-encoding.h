@@ -7,6 +7,7 @@ typedef struct Arith Arith;
 
 extern Arith* arith_Create( void );
 extern void   arith_Destroy(          Arith* arith );
+extern void   arith_Use_Range_Coder(  Arith* arith,   bool range_coder );   /* Before starting. */
 
 extern void   arith_Start_Decoding(   Arith* arith,   u08* out_buf );
 extern void   arith_Start_Encoding(   Arith* arith,   u08* out_buf ); /* DANGER! Writes to buf[-1] !! */
@@ -19,4 +20,16 @@ extern void   arith_Encode_1_Of_N(    Arith* arith,   u32 low,   u32 high,   u32
 extern void   arith_Decode_1_Of_N(    Arith* arith,   u32 low,   u32 high,   u32 total );
 extern u32  arith_Get_1_Of_N(       Arith* arith,   u32 total );
 
+/* Charge all coding to PHASE_ARITH (see phase.h).  */
+/* arithmetic-encoding.c defines ARITHMETIC_ENCODING_C */
+/* to keep these off its own definitions:             */
+#if defined( PZIP_PHASES ) && !defined( ARITHMETIC_ENCODING_C )
+#include "phase.h"
+#define arith_Encode_Bit(    ... )   PHASED_VOID( PHASE_ARITH, arith_Encode_Bit(    __VA_ARGS__ ) )
+#define arith_Decode_Bit(    ... )   PHASED(      PHASE_ARITH, arith_Decode_Bit(    __VA_ARGS__ ) )
+#define arith_Encode_1_Of_N( ... )   PHASED_VOID( PHASE_ARITH, arith_Encode_1_Of_N( __VA_ARGS__ ) )
+#define arith_Decode_1_Of_N( ... )   PHASED_VOID( PHASE_ARITH, arith_Decode_1_Of_N( __VA_ARGS__ ) )
+#define arith_Get_1_Of_N(    ... )   PHASED(      PHASE_ARITH, arith_Get_1_Of_N(    __VA_ARGS__ ) )
+#endif /* PZIP_PHASES */
+
 #endif /* ARITHMETIC_ENCODING_H */
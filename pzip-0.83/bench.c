@@ -0,0 +1,413 @@
+/* bench.c:  'make bench' -- time pzip in-process on a fixed set */
+/* of synthetic inputs, plus any files named on the command line, */
+/* reporting speed, compression and memory as JSON on stdout.     */
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "pzip.h"
+#include "config.h"
+#include "version.h"
+#include "inc.h"
+#include "crc32.h"
+#include "safe.h"
+#include "intmath.h"
+
+#define PREAMBLE	(1024)	/* As in main.c. */
+
+int verbose = FALSE;
+
+static void io_die( const char* plaint, const char* filename ) {
+    char buf[ 1023 ];
+    sprintf( buf, plaint, filename );
+    perror( buf );
+    exit( 1 );
+}
+
+/*****************************************************************/
+/* The synthetic corpus.  Each generator fills 'len' bytes from  */
+/* its own fixed seed, so every build benchmarks the very same   */
+/* bytes, and none of them depends on files we don't ship.       */
+/*****************************************************************/
+
+static u64 rng_state;
+
+static u32 rng( void ) {
+    /* xorshift64*, plenty good enough for test data: */
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (u32)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static uint below( uint n ) {   return rng() % n;   }
+
+static uint zipf( uint n ) {
+    /* Roughly Zipfian pick from 0..n-1, favoring low numbers: */
+    uint r = below( n );
+    return below( r +1 );
+}
+
+static const char* words[] = {
+    "the", "of", "and", "to", "a", "in", "that", "is", "was", "he", "for", "it", "with", "as", "his",
+    "on", "be", "at", "by", "had", "not", "are", "but", "from", "or", "have", "an", "they", "which",
+    "one", "you", "were", "her", "all", "she", "there", "would", "their", "we", "him", "been", "has",
+    "when", "who", "will", "more", "no", "if", "out", "so", "said", "what", "up", "its", "about",
+    "into", "than", "them", "can", "only", "other", "new", "some", "could", "time", "these", "two",
+    "may", "then", "do", "first", "any", "my", "now", "such", "like", "our", "over", "man", "me",
+    "even", "most", "made", "after", "also", "did", "many", "before", "must", "through", "back",
+    "years", "where", "much", "your", "way", "well", "down", "should", "because", "each", "just",
+    "those", "people", "how", "too", "little", "state", "good", "very", "make", "world", "still",
+    "own", "see", "men", "work", "long", "get", "here", "between", "both", "life", "being", "under",
+    "never", "day", "same", "another", "know", "while", "last", "might", "us", "great", "old", "year",
+    "off", "come", "since", "against", "go", "came", "right", "used", "take", "three", "house",
+    "compression", "arithmetic", "context", "symbol", "model", "probability", "escape", "order",
+};
+#define WORDS ((uint)(sizeof( words ) / sizeof( words[0] )))
+
+static const char* keywords[] = {
+    "int", "u32", "bool", "return", "if", "else", "for", "while", "static", "const", "void",
+    "struct", "sizeof", "break", "case", "switch", "NULL", "TRUE", "FALSE", "assert",
+};
+#define KEYWORDS ((uint)(sizeof( keywords ) / sizeof( keywords[0] )))
+
+static const char* hosts[]   = { "alpha", "bravo", "charlie", "delta", "echo" };
+static const char* daemons[] = { "sshd", "cron", "kernel", "httpd", "postfix/smtpd", "named" };
+static const char* events[]  = {
+    "Accepted password for %s from 10.%u.%u.%u port %u ssh2",
+    "session opened for user %s by (uid=0)",
+    "GET /index.html HTTP/1.1 200 %u",
+    "connect from unknown[192.168.%u.%u]",
+    "(%s) CMD (run-parts /etc/cron.hourly)",
+    "client 10.%u.%u.%u#%u: query: example.com IN A",
+};
+
+static u08* put_string( u08* p, u08* end, const char* s ) {
+    while (*s && p < end)   *p++ = *s++;
+    return p;
+}
+
+static void make_text( u08* buf, uint len ) {
+    u08* p   = buf;
+    u08* end = buf + len;
+    uint col = 0;
+    bool cap = TRUE;
+    while (p < end) {
+        const char* w = words[ zipf( WORDS ) ];
+        uint n = strlen( w );
+        if (col + n >= 72) {   p = put_string( p, end, "\n" );   col = 0;   }
+        else if (col)      {   p = put_string( p, end, " "  );   ++col;     }
+        if (cap && p < end) {   *p++ = w[0] - 'a' + 'A';   ++w;   --n;   ++col;   cap = FALSE;   }
+        p    = put_string( p, end, w );
+        col += n;
+        if (!below( 12 )) {   p = put_string( p, end, below( 4 ) ? "." : "," );   cap = (p[-1] == '.');   ++col;   }
+    }
+}
+
+static void make_source( u08* buf, uint len ) {
+    u08* p     = buf;
+    u08* end   = buf + len;
+    int  depth = 0;
+    char line[ 256 ];
+    while (p < end) {
+        uint        r = below( 10 );
+        int         i;
+        const char* w[4];
+        for (i = 0;   i < depth * 4;   ++i)   p = put_string( p, end, " " );
+        if (r == 0 && depth < 4) {
+            const char* k = keywords[ 4 + below( 3 ) ];
+            uint        n;
+            w[0] = words[ zipf( WORDS ) ];
+            w[1] = words[ zipf( WORDS ) ];
+            n    = below( 256 );
+            sprintf( line, "%s (%s_%s < %u) {\n", k, w[0], w[1], n );
+            ++depth;
+        } else if (r == 1 && depth > 0) {
+            sprintf( line, "}\n" );
+            --depth;
+        } else if (r < 5) {
+            const char* k = keywords[ zipf( 3 ) ];
+            uint        n;
+            for (i = 0;   i < 3;   ++i)   w[i] = words[ zipf( WORDS ) ];
+            n = below( 100 );
+            sprintf( line, "%s %s_%s = %s( self, %u );\n", k, w[0], w[1], w[2], n );
+        } else if (r < 7) {
+            for (i = 0;   i < 4;   ++i)   w[i] = words[ zipf( WORDS ) ];
+            sprintf( line, "/* %s %s %s %s. */\n", w[0], w[1], w[2], w[3] );
+        } else {
+            w[0] = words[ zipf( WORDS ) ];
+            w[1] = words[ zipf( WORDS ) ];
+            sprintf( line, "%s->%s += %s;\n", w[0], w[1], keywords[ below( KEYWORDS ) ] );
+        }
+        p = put_string( p, end, line );
+    }
+}
+
+static void make_logs( u08* buf, uint len ) {
+    u08* p   = buf;
+    u08* end = buf + len;
+    uint t   = 1080000000;
+    char line[ 256 ];
+    char event[ 160 ];
+    while (p < end) {
+        time_t      now;
+        struct tm*  tm;
+        uint        e, a, b, c, port, pid;
+        const char *w, *host, *daemon;
+        t  += below( 5 );
+        now = t;
+        tm  = gmtime( &now );
+        /* Draw everything first, in a fixed order:  the */
+        /* order arguments are evaluated in is not, and  */
+        /* each format below takes only what it prints.  */
+        e      = zipf( 6 );
+        w      = words[ zipf( WORDS ) ];
+        a      = below( 256 );
+        b      = below( 256 );
+        c      = below( 256 );
+        port   = 1024 + below( 60000 );
+        host   = hosts[ zipf( 5 ) ];
+        daemon = daemons[ zipf( 6 ) ];
+        pid    = 100 + below( 30000 );
+        switch (e) {
+            case 0:    sprintf( event, events[e], w, a, b, c, port );   break;
+            case 1:    sprintf( event, events[e], w );                  break;
+            case 2:    sprintf( event, events[e], port );               break;
+            case 3:    sprintf( event, events[e], a, b );               break;
+            case 4:    sprintf( event, events[e], w );                  break;
+            default:   sprintf( event, events[e], a, b, c, port );      break;
+        }
+        strftime( line, 32, "%b %d %H:%M:%S", tm );
+        sprintf( line + strlen( line ), " %s %s[%u]: %s\n", host, daemon, pid, event );
+        p = put_string( p, end, line );
+    }
+}
+
+static void make_binary( u08* buf, uint len ) {
+    /* A table of 16-byte records:  an increasing id, */
+    /* a few small fields and a slowly drifting value: */
+    u08* p     = buf;
+    u32  id    = 1000;
+    u32  value = 500000;
+    while (p + 16 <= buf + len) {
+        u16 kind  = zipf( 40 );
+        u16 flags = below( 4 ) << 8;
+        u32 pad   = 0;
+        id    += 1 + zipf( 3 );
+        value += below( 2001 ) - 1000;
+        memcpy( p +  0, &id,    4 );
+        memcpy( p +  4, &kind,  2 );
+        memcpy( p +  6, &flags, 2 );
+        memcpy( p +  8, &value, 4 );
+        memcpy( p + 12, &pad,   4 );
+        p += 16;
+    }
+    memset( p, 0, buf + len - p );
+}
+
+static void make_random( u08* buf, uint len ) {
+    uint i;
+    for (i = 0;   i < len;   ++i)   buf[i] = rng();
+}
+
+static void make_repetitive( u08* buf, uint len ) {
+    /* One 4K block over and over, with the odd byte changed: */
+    uint i;
+    make_text( buf, min( len, 4096 ) );
+    for (i = 4096;   i < len;   ++i) {
+        buf[i] = below( 2000 ) ? buf[ i - 4096 ] : rng();
+    }
+}
+
+static struct {
+    const char* name;
+    void        (*make)( u08* buf, uint len );
+} synthetic[] = {
+    { "text",       make_text       },
+    { "source",     make_source     },
+    { "logs",       make_logs       },
+    { "binary",     make_binary     },
+    { "random",     make_random     },
+    { "repetitive", make_repetitive },
+};
+#define SYNTHETICS ((int)(sizeof( synthetic ) / sizeof( synthetic[0] )))
+
+/*****************************************************************/
+/* Measurement.                                                  */
+/*****************************************************************/
+
+static double now( void ) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void reset_peak_rss( void ) {
+    /* Linux lets us restart VmHWM so that each */
+    /* input gets its own peak;  elsewhere we   */
+    /* just report the peak so far:             */
+    FILE* fp = fopen( "/proc/self/clear_refs", "w" );
+    if (fp) {   fputs( "5", fp );   fclose( fp );   }
+}
+
+static long peak_rss_kb( void ) {
+    char  line[ 256 ];
+    long  kb = -1;
+    FILE* fp = fopen( "/proc/self/status", "r" );
+    if (fp) {
+        while (fgets( line, sizeof( line ), fp )) {
+            if (!strncmp( line, "VmHWM:", 6 ))   kb = atol( line + 6 );
+        }
+        fclose( fp );
+    }
+    if (kb < 0) {
+        struct rusage ru;
+        getrusage( RUSAGE_SELF, &ru );
+        kb = ru.ru_maxrss;
+    }
+    return kb;
+}
+
+static void json_string( const char* s ) {
+    putchar( '"' );
+    for (;   *s;   ++s) {
+        if (*s == '"' || *s == '\\')   putchar( '\\' );
+        if ((u08)*s < ' ')   printf( "\\u%04x", (u08)*s );
+        else                 putchar( *s );
+    }
+    putchar( '"' );
+}
+
+static bool first_result = TRUE;
+
+static bool bench( const char* name,   u08* input_buf,   uint input_len,   int reps ) {
+
+    /* Compress and decompress 'input_buf' 'reps' times, */
+    /* keeping the best times, and report one result.    */
+    /* Returns TRUE iff every round trip was exact:       */
+
+    u08*   encode_buf = safe_Malloc( input_len*2 + 65536 + PREAMBLE );
+    u08*   decode_buf = safe_Malloc( input_len   + 1024  + PREAMBLE );
+    double encode_best = 1e30;
+    double decode_best = 1e30;
+    uint   encode_len  = 0;
+    bool   ok          = TRUE;
+    long   rss;
+    int    r;
+
+    memset( encode_buf, 0,   PREAMBLE );   encode_buf += PREAMBLE;
+    memset( decode_buf, ' ', PREAMBLE );   decode_buf += PREAMBLE;
+
+    reset_peak_rss();
+
+    for (r = 0;   r < reps;   ++r) {
+        double t0, t1, t2;
+        memset( decode_buf, 0, input_len );
+        t0 = now();   encode_len = pzip_Encode( input_buf, input_len, encode_buf );
+        t1 = now();   pzip_Decode( decode_buf, input_len, encode_buf );
+        t2 = now();
+        encode_best = min( encode_best, t1 - t0 );
+        decode_best = min( decode_best, t2 - t1 );
+        if (memcmp( input_buf, decode_buf, input_len )
+        ||  crc32_Compute_Checksum( decode_buf, input_len ) != crc32_Compute_Checksum( input_buf, input_len )
+        ){
+            ok = FALSE;
+        }
+    }
+
+    rss = peak_rss_kb();
+
+    printf( "%s\n    { \"name\": ", first_result ? "" : "," );
+    json_string( name );
+    printf( ", \"bytes\": %u, \"packed\": %u, \"bpc\": %.4f,\n", input_len, encode_len, input_len ? encode_len * 8.0 / input_len : 0.0 );
+    printf( "      \"compress_seconds\": %.4f, \"compress_mb_per_sec\": %.4f,\n",     encode_best, input_len / 1e6 / encode_best );
+    printf( "      \"decompress_seconds\": %.4f, \"decompress_mb_per_sec\": %.4f,\n", decode_best, input_len / 1e6 / decode_best );
+    printf( "      \"peak_rss_kb\": %ld, \"roundtrip\": %s }", rss, ok ? "true" : "false" );
+    fflush( stdout );
+    first_result = FALSE;
+
+    if (!ok)   fprintf( stderr, "***** %s: Decode failed!\n", name );
+
+    free( encode_buf - PREAMBLE );
+    free( decode_buf - PREAMBLE );
+
+    return ok;
+}
+
+int main(  int argc,   char* argv[] ) {
+
+    uint size          = 1 << 20;
+    int  reps          = 1;
+    bool synthetic_too = TRUE;
+    int  failures      = 0;
+    int  i;
+
+    ++argv;
+    --argc;
+
+    /* Options first, as in main.c, then files: */
+    while (argc > 0 && **argv == '-') {
+        char* str = *argv++ + 1;
+        argc--;
+
+        switch (*str++) {
+        case 's':   size = atoi( str ) * 1024;                             break;
+        case 'n':   reps = max( 1, atoi( str ) );                          break;
+        case 'x':   synthetic_too = FALSE;                                 break;
+        case 't':   pzip_lookahead_thread = TRUE;                          break;
+        case 'd':   pzip_options |= PZIP_OPTION_DEFER_CONTEXTS;            break;
+        case 'm':   pzip_options |= PZIP_OPTION_DET_CHAINS;                break;
+        case 'r':   pzip_options |= PZIP_OPTION_LONG_REPEATS;              break;
+        case 'f':   pzip_options |= PZIP_OPTION_MATCH_RUNS;                break;
+        case 'c':   pzip_options |= PZIP_OPTION_RANGE_CODER;               break;
+        default:
+            fprintf(stderr, "Usage : pzip-bench [options] [files]\n" );
+            fprintf(stderr, "options :\n" );
+            fprintf(stderr, " -sN : synthetic inputs of N KB each [default 1024]\n");
+            fprintf(stderr, " -nN : best of N runs per input [default 1]\n");
+            fprintf(stderr, " -x  : skip the synthetic inputs\n");
+            fprintf(stderr, " -t -d -m -r -f -c : as for pzip\n");
+            exit(1);
+        }
+    }
+
+    intmath_init();
+
+    printf( "{ \"version\": %.2f, \"options\": %u, \"results\": [", VERSION, pzip_options );
+
+    if (synthetic_too) {
+        u08* buf = safe_Malloc( size + 1024 + PREAMBLE );
+        memset( buf, ' ', PREAMBLE );
+        buf += PREAMBLE;
+        for (i = 0;   i < SYNTHETICS;   ++i) {
+            rng_state = 0x9E3779B97F4A7C15ULL * (i +1);
+            synthetic[i].make( buf, size );
+            if (!bench( synthetic[i].name, buf, size, reps ))   ++failures;
+        }
+        free( buf - PREAMBLE );
+    }
+
+    for (i = 0;   i < argc;   ++i) {
+        FILE* fp = fopen( argv[i], "r" );
+        u08*  buf;
+        long  len;
+        if (!fp)   io_die( "bench.c:main(): Couldn't open input file '%s'", argv[i] );
+        fseek( fp, 0, SEEK_END );
+        len = ftell( fp );
+        fseek( fp, 0, SEEK_SET );
+        buf = safe_Malloc( len + 1024 + PREAMBLE );
+        memset( buf, ' ', PREAMBLE );
+        buf += PREAMBLE;
+        if (fread( buf, 1, len, fp ) != (size_t)len)   io_die( "bench.c:main(): Couldn't read input file '%s'", argv[i] );
+        fclose( fp );
+        if (!bench( argv[i], buf, len, reps ))   ++failures;
+        free( buf - PREAMBLE );
+    }
+
+    printf( "\n] }\n" );
+
+    pzip_Release();
+
+    exit( failures ? 1 : 0 );
+}
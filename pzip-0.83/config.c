@@ -6,6 +6,9 @@
 
 const uint DETERMINISTIC_MIN_LEN_INC =  2;          /* XXX '1' works a teensy better on the Calgary Corpus, for me. -- CrT */
 const uint DETERMINISTIC_MIN_ORDER   = 24;
+const uint DETERMINISTIC_WINDOW_BITS     = 18;      /* A 256k window unless PZIP_OPTION_DET_WINDOW says otherwise. */
+const uint DETERMINISTIC_WINDOW_BITS_MIN = 10;
+const uint DETERMINISTIC_WINDOW_BITS_MAX = 26;      /* 64M positions, 768MB of nodes. */
 
 const int CONTEXT_SYMBOL_INC_NOVEL  = 1;
 const int CONTEXT_SYMBOL_INC        = 1;            /* 2 for PPMD , 1 for PPMC */
@@ -13,6 +16,8 @@ const int CONTEXT_ESCP_INC          = 1;
 
 const int CONTEXT_ESCAPE_MAX             = 20;    /* Never let escape_count get bigger than this. */
 const int CONTEXT_COUNT_HALVE_THRESHOLD  = 4096;  /* Seems to matter very little.  Even order0 doesn't hit this much. */
+const int CONTEXT_DEFER_MIN_ORDER        = 6;     /* Lowest order whose creation PZIP_OPTION_DEFER_CONTEXTS defers. */
+const int CONTEXT_ARRAY_MIN_SYMBOLS      = 32;    /* Follow sets this big move into a Followset_Array. */
 
 #ifdef _DEBUG
 const int PZIP_PRINTF_INTERVAL = 1000;
@@ -10,6 +10,9 @@
 
 extern const uint DETERMINISTIC_MIN_LEN_INC;
 extern const uint DETERMINISTIC_MIN_ORDER  ;
+extern const uint DETERMINISTIC_WINDOW_BITS;
+extern const uint DETERMINISTIC_WINDOW_BITS_MIN;
+extern const uint DETERMINISTIC_WINDOW_BITS_MAX;
 
 extern const int CONTEXT_SYMBOL_INC_NOVEL;
 extern const int CONTEXT_SYMBOL_INC      ;
@@ -17,6 +20,8 @@ extern const int CONTEXT_ESCP_INC     ;
 
 extern const int CONTEXT_ESCAPE_MAX           ;
 extern const int CONTEXT_COUNT_HALVE_THRESHOLD;
+extern const int CONTEXT_DEFER_MIN_ORDER      ;
+extern const int CONTEXT_ARRAY_MIN_SYMBOLS    ;
 
 extern const int PZIP_PRINTF_INTERVAL;
 
@@ -3,6 +3,24 @@
 #include "config.h"
 #include "pool.h"
 #include "hash.h"
+#include "huge.h"
+
+/* Trie.seen_suffixes is set-associative, one cache */
+/* line per bucket.  A direct-mapped table lost too  */
+/* many suffixes to collisions:  Two suffixes in one */
+/* slot kept evicting each other, and so never got   */
+/* their Contexts at all.                            */
+#define TRIE_SEEN_SHIFT (17)
+#define TRIE_SEEN_SLOTS (1U << TRIE_SEEN_SHIFT)       /* Buckets. */
+#define TRIE_SEEN_WAYS  (6)
+
+struct Seen_Bucket {
+    u08* at[  TRIE_SEEN_WAYS ];         /* Where each suffix last ended in the input, else NULL. */
+    u16  tag[ TRIE_SEEN_WAYS ];         /* Some hash bits, to skip comparing most bytes.         */
+    u32  unused;
+};
+
+typedef char seen_bucket_size_check[ sizeof( Seen_Bucket ) == 64   ?   1   :   -1 ];
 
     /**************************************/
     /* SEE ALSO the comments in context.h */
@@ -24,13 +42,16 @@ Context : Just track seen symbols, counts & escapes; no coding here
 
 
 /*****************************************/
-/* static pools                          */
+/* static state                          */
 
-static Pool* context_node_pool       = NULL;
-static int   context_node_pool_count = 0;
-
-static Pool* pool        = NULL;
-static int   pool_count  = 0;
+/* What context_Encode()/context_Decode() learned about */
+/* the current symbol, for context_Update_Active_Contexts(): */
+static struct {
+    Context*         coded_context;     /* Context which coded the symbol, else NULL.   */
+    Followset_Node** coded_last;        /* find_symbol() result for coded_context.      */
+    int              coded_index;       /* find_entry() result, if it has an array.     */
+    u32              absent;            /* Bit N set iff symbol not in order N's set.   */
+} memo;
 
 /*                                       */
 /*****************************************/
@@ -38,11 +59,18 @@ static int   pool_count  = 0;
 Contexts active_contexts;
 Trie* trie;
 
-static Context* context_create(   Suffix suffix,   int order   ) {
+static Context* context_create(   Trie* trie,   Suffix suffix,   int order   ) {
 
-    Context* self = pool_Auto_Get_Hunk( &pool, &pool_count, sizeof(Context) );
+    Context* self = trie->free_contexts;
+
+    if (self) {
+        trie->free_contexts = self->parent;
+    } else {
+        assert( trie->context_arena_used < trie->context_arena_size );
+        self = &trie->context_arena[ trie->context_arena_used++ ];
+    }
+    memset( self, 0, sizeof( Context ) );
 
-    self->hashlink = NULL;
     self->parent   = NULL;
     self->order    = order;
     self->kids     = 0;
@@ -53,6 +81,7 @@ static Context* context_create(   Suffix suffix,   int order   ) {
 
     self->suffix             = suffix;
     self->followset          = NULL;
+    self->followset_array    = NULL;
     self->followset_size     = 0;
     self->total_symbol_count = 0;
     self->max_count          = 0;
@@ -75,18 +104,23 @@ static Context* context_create(   Suffix suffix,   int order   ) {
     return self;
 }
 
-void context_Destroy_All_Contexts( void ) {
-    /* XXX we're not catching the subclass pools right now */
-    pool_Auto_Destroy( &context_node_pool, &context_node_pool_count );
+static inline bool is_present(   Followset_Array* array,   int symbol   ) {
+    return (array->present[ symbol >> 6 ] >> (symbol & 63)) & 1;
+}
+
+static inline void set_present(   Followset_Array* array,   int symbol   ) {
+    array->present[ symbol >> 6 ] |= 1ULL << (symbol & 63);
 }
 
-static void maybe_halve_counts( Context* self ) {
+static bool maybe_halve_counts( Context* self ) {
+
+    int old_size = self->followset_size;
 
     /* To keep the logic in our arithmetic encoder  */
     /* from overflowing, we must periodically halve */
     /* the appearance counts in our follow set:     */
 
-    if (self->total_symbol_count < CONTEXT_COUNT_HALVE_THRESHOLD)   return;
+    if (self->total_symbol_count < CONTEXT_COUNT_HALVE_THRESHOLD)   return FALSE;
 
     /* Recompute our symbol statistics */
     /* from scratch as we go:          */ 
@@ -94,7 +128,28 @@ static void maybe_halve_counts( Context* self ) {
     self->total_symbol_count = 0;      /* Sum of all follow->counts.         */
     self->max_count          = 0;      /* Max of all follow->counts.         */
 
-    {   Followset_Node*  node;
+    if (self->followset_array) {
+
+        /* Same again, closing up the gaps as we go: */
+        Followset_Array* array = self->followset_array;
+        int i;
+        memset( array->present, 0, sizeof( array->present ) );
+        for (i = 0;   i < old_size;   ++i) {
+            int count = array->count[i] >> 1;
+            if (count == 0)   continue;
+            set_present( array, array->symbol[i] );
+            if (count <= CONTEXT_SYMBOL_INC_NOVEL)   count = CONTEXT_SYMBOL_INC_NOVEL +1;
+
+            array->symbol[ self->followset_size   ] = array->symbol[i];
+            array->count[  self->followset_size++ ] = count;
+
+            self->total_symbol_count += count;
+            self->max_count = max( self->max_count, count );
+        }
+
+    } else {
+
+        Followset_Node*  node;
         Followset_Node** node_ptr;
     
         /* Over all symbols which have followed this context: */
@@ -108,7 +163,7 @@ static void maybe_halve_counts( Context* self ) {
                 /* The count has gone to zero, */
                 /* so delete the node:         */ 
                 *node_ptr = node->next;        /* Remove node from our linklist. */
-                pool_Auto_Free_Hunk( &context_node_pool, &context_node_pool_count, node );
+                pool_Auto_Free_Hunk( &trie->context_node_pool, &trie->context_node_pool_count, node );
 
             } else {
 
@@ -128,80 +183,191 @@ static void maybe_halve_counts( Context* self ) {
     }
         
     self->escape_count = (self->escape_count >> 1) +1;
+
+    return TRUE;
 }
 
 
-void context_Update(   Context* self,   int symbol,   u32 key,   See* see,   int coded_order   ) {
+static Followset_Node** find_symbol(   Context* self,   int symbol   ) {
 
-    /* <> could track the 'if I had coded' entropy here */
+    /* Return the link pointing to the Followset_Node */
+    /* for 'symbol', or NULL if it is not in our set: */
+
+    Followset_Node** last;
+    Followset_Node*  node;
+    for (last = &self->followset;   node = *last;   last = &node->next) {
+        if (node->symbol == symbol)   return last;
+    }
+    return NULL;
+}
+
+static inline int find_entry(   Context* self,   int symbol   ) {
+
+    /* Same for a Followset_Array, returning */
+    /* the index of 'symbol' else -1:        */
+
+    u08* at;
+    if (!is_present( self->followset_array, symbol ))   return -1;
+    at = memchr( self->followset_array->symbol, symbol, self->followset_size );
+    return at - self->followset_array->symbol;
+}
+
+static inline void count_repeat(   Context* self,   u16* count   ) {
+
+    /* Bump the 'count' of a symbol already in our set: */
+
+    if (*count <= CONTEXT_SYMBOL_INC_NOVEL) {
+
+        self->escape_count       -= CONTEXT_ESCP_INC;
+        *count                   += CONTEXT_SYMBOL_INC - CONTEXT_SYMBOL_INC_NOVEL;
+        self->total_symbol_count += CONTEXT_SYMBOL_INC - CONTEXT_SYMBOL_INC_NOVEL;
+
+        if (self->escape_count < 1) {
+            self->escape_count = 1;
+        }
+    }
+
+    *count                   += CONTEXT_SYMBOL_INC;
+    self->total_symbol_count += CONTEXT_SYMBOL_INC;
+
+    self->max_count = max( self->max_count, *count );
+}
+
+static inline void count_novel(   Context* self,   u16* count   ) {
+
+    /* Start the 'count' of a symbol new to our set: */
+
+    *count = CONTEXT_SYMBOL_INC_NOVEL;
+
+    self->total_symbol_count += CONTEXT_SYMBOL_INC_NOVEL;       
+
+    if (self->escape_count < CONTEXT_ESCAPE_MAX) {
+        self->escape_count += CONTEXT_ESCP_INC;
+    }
+
+    ++ self->followset_size;
+
+    self->max_count = max( self->max_count, *count );
+}
+
+static void move_followset_to_array(   Context* self   ) {
+
+    /* Our linklist has grown big enough that walking it */
+    /* costs more than shuffling an array would, so copy */
+    /* it, in order, into a Followset_Array:             */
+
+    Followset_Array* array = pool_Get_Hunk( trie->followset_array_pool );
+    Followset_Node*  node;
+    Followset_Node*  next;
+    int              i = 0;
+
+    memset( array->present, 0, sizeof( array->present ) );
+    for (node = self->followset;   node;   node = next) {
+        next = node->next;
+        set_present( array, node->symbol );
+        array->symbol[ i   ] = node->symbol;
+        array->count[  i++ ] = node->count;
+        pool_Auto_Free_Hunk(   &trie->context_node_pool,   &trie->context_node_pool_count,   node   );
+    }
+    assert( i == self->followset_size );
+
+    self->followset       = NULL;
+    self->followset_array = array;
+}
+
+static void update_followset(   Context* self,   int symbol,   Followset_Node** last   ) {
 
     /*************************************************************/
     /* 'symbol' has appeared immediately following this context; */
     /* Update the followset statistics to reflect this fact.    */
+    /* 'last' is as returned by find_symbol().                   */
     /*************************************************************/
 
-    assert( ! self->parent || self->parent->order == (self->order - 1) );
+    Followset_Node* node;
 
-    if (self->order < coded_order)   return;
+    if (last) {
 
-    {   Followset_Node** last;
-        Followset_Node*  node;
-        bool             escape = TRUE;
+        node = *last;
 
-        maybe_halve_counts( self );
+        /* Move 'node' to front of linklist to reduce */
+        /* average search time in future.  (This cut  */
+        /* pzip runtime by 12.5% when I added it.)    */
+        *last            = node->next;              
+        node->next       = self->followset;
+        self->followset = node;
 
-        /* Check first to see if we already */
-        /* have 'symbol' in our followset:  */
-        for (last = &self->followset;   node = *last;   last = &node->next) {
+        count_repeat( self, &node->count );
 
-            if (node->symbol == symbol) {
+    } else {
 
-                /* Move 'node' to front of linklist to reduce */
-                /* average search time in future.  (This cut  */
-                /* pzip runtime by 12.5% when I added it.)    */
-                *last            = node->next;              
-                node->next       = self->followset;
-                self->followset = node;
+        /* Add a new node to our follow set: */
+        node             = pool_Auto_Get_Hunk( &trie->context_node_pool, &trie->context_node_pool_count, sizeof( Followset_Node ) );
+        node->next       = self->followset;
+        self->followset = node;
 
-                if (node->count <= CONTEXT_SYMBOL_INC_NOVEL) {
+        node->symbol   = symbol;
 
-                    self->escape_count       -= CONTEXT_ESCP_INC;
-                    node->count              += CONTEXT_SYMBOL_INC - CONTEXT_SYMBOL_INC_NOVEL;
-                    self->total_symbol_count += CONTEXT_SYMBOL_INC - CONTEXT_SYMBOL_INC_NOVEL;
+        count_novel( self, &node->count );
 
-                    if (self->escape_count < 1) {
-                        self->escape_count = 1;
-                    }
-                }
+        if (self->followset_size >= CONTEXT_ARRAY_MIN_SYMBOLS)   move_followset_to_array( self );
+    }
+}
 
-                node->count              += CONTEXT_SYMBOL_INC;
-                self->total_symbol_count += CONTEXT_SYMBOL_INC;
+static void update_followset_array(   Context* self,   int symbol,   int i   ) {
 
-                escape = FALSE;
-                break;
-            }
-        }
+    /* Same as update_followset(), for a Followset_Array. */
+    /* 'i' is as returned by find_entry().                */
 
-        if (escape) {
+    Followset_Array* array = self->followset_array;
+    u16              count;
 
-            /* Add a new node to our follow set: */
-            node             = pool_Auto_Get_Hunk( &context_node_pool, &context_node_pool_count, sizeof( Followset_Node ) );
-            node->next       = self->followset;
-            self->followset = node;
+    if (i >= 0) {
+        count = array->count[i];
+        count_repeat( self, &count );
+    } else {
+        count_novel( self, &count );
+        set_present( array, symbol );
+        i = self->followset_size - 1;
+    }
 
-            node->symbol   = symbol;
-            node->count    = CONTEXT_SYMBOL_INC_NOVEL;
+    /* Move (or put) it at the front, as above: */
+    memmove( array->symbol +1,   array->symbol,   i                 );
+    memmove( array->count  +1,   array->count,    i * sizeof( u16 ) );
+    array->symbol[0] = symbol;
+    array->count[0]  = count;
+}
 
-            self->total_symbol_count += CONTEXT_SYMBOL_INC_NOVEL;       
+static bool learn_symbol(   Context* self,   int symbol,   bool absent,   bool coded   ) {
 
-            if (self->escape_count < CONTEXT_ESCAPE_MAX) {
-                self->escape_count += CONTEXT_ESCP_INC;
-            }
+    /* Note that 'symbol' followed 'self', returning TRUE */
+    /* iff it was novel.  If 'absent', we know it is not  */
+    /* in our set; if 'coded', we coded it and 'memo'     */
+    /* says where it is -- unless halving moves it.       */
 
-            ++ self->followset_size;
-        }
+    if (maybe_halve_counts( self ))   coded = FALSE;
 
-        self->max_count = max( self->max_count, node->count );
+    if (self->followset_array) {
+        int i = absent ? -1 : coded ? memo.coded_index : find_entry( self, symbol );
+        update_followset_array( self, symbol, i );
+        return i < 0;
+    } else {
+        Followset_Node** last = absent ? NULL : coded ? memo.coded_last : find_symbol( self, symbol );
+        update_followset( self, symbol, last );
+        return !last;
+    }
+}
+
+void context_Update(   Context* self,   int symbol,   u32 key,   See* see,   int coded_order   ) {
+
+    /* <> could track the 'if I had coded' entropy here */
+
+    assert( ! self->parent || self->parent->order == (self->order - 1) );
+
+    if (self->order < coded_order)   return;
+
+    if (see)   see_Forget( see );
+
+    {   bool novel = learn_symbol( self, symbol, FALSE, FALSE );
 
         if (!see) {
             self->see_state = NULL;
@@ -209,12 +375,87 @@ void context_Update(   Context* self,   int symbol,   u32 key,   See* see,   int
             // Note that this may or may not be 
             // the same state that we coded from, because
             // of exclusions and such
-            see_Adjust_State( see, self->see_state, escape );
+            see_Adjust_State( see, self->see_state, novel );
             self->see_state = see_Get_State(   see,   self->escape_count,   self->total_symbol_count,   key,   self   );
         }
     }
 }
 
+void context_Update_Active_Contexts(   int symbol,   u32 key,   See* see,   int coded_order   ) {
+
+    /******************************************************/
+    /* Same as calling context_Update() on each of        */
+    /* active_contexts.c[ 0..PZIP_ORDER ] in turn, but    */
+    /* uses what context_Encode()/context_Decode() just   */
+    /* learned (in 'memo') to avoid rescanning followsets */
+    /* and holds back the See_State adjustments until     */
+    /* the end, where we can issue their cache misses     */
+    /* together.  That reordering is safe because         */
+    /* see_Get_State() never reads the statistics which   */
+    /* see_Adjust_State() modifies.                       */
+    /******************************************************/
+
+    See_State* adjust[ PZIP_ORDER +1 ];
+    bool       escape[ PZIP_ORDER +1 ];
+    int        adjusts = 0;
+
+    int      order;
+    Context* self;
+
+    if (see)   see_Forget( see );
+
+    for (order = coded_order;   order <= PZIP_ORDER && (self = active_contexts.c[ order ]);   ++order) {
+
+        bool novel;
+
+        assert( ! self->parent || self->parent->order == (self->order - 1) );
+
+        novel = learn_symbol( self,   symbol,   memo.absent & (1U << order),   self == memo.coded_context );
+
+        if (!see) {
+            self->see_state = NULL;
+        } else {
+            if (self->see_state) {
+                __builtin_prefetch( self->see_state );
+                adjust[ adjusts   ] = self->see_state;
+                escape[ adjusts++ ] = novel;
+            }
+            self->see_state = see_Get_State(   see,   self->escape_count,   self->total_symbol_count,   key,   self   );
+        }
+    }
+
+    {   int i;
+        for (i = 0;   i < adjusts;   ++i)   see_Adjust_State( see, adjust[i], escape[i] );
+    }
+
+    memo.coded_context = NULL;
+    memo.absent        = 0;
+}
+
+static inline void tally(   Followset_Stats* stats,   Excluded_Symbols* excl,   int symbol,   int count   ) {
+
+    /* One symbol's share of the stats below: */
+
+    if (excluded_symbols_Contains( excl, symbol ) ) {
+
+        if (count <= CONTEXT_SYMBOL_INC_NOVEL) {
+            stats->escape_count += CONTEXT_EXCLUDED_ESCAPE_EXCLUDEDINC;
+        }
+
+    } else {
+
+        stats->total_count += count;
+
+        if (count > stats->max_count) {
+            stats->max_count = count;
+        }
+
+        if (count <= CONTEXT_SYMBOL_INC_NOVEL) {
+            stats->escape_count += CONTEXT_EXCLUDED_ESCAPE_INC;
+        }
+    }
+}
+
 Followset_Stats context_Get_Followset_Stats_With_Given_Symbols_Excluded(   Context* self,   Excluded_Symbols* excl   ) {
 
     /**********************************************/
@@ -238,8 +479,6 @@ Followset_Stats context_Get_Followset_Stats_With_Given_Symbols_Excluded(   Conte
 
     } else {
 
-        Followset_Node * n;
-
         // escape from un-excluded counts
         //      also count the excluded escape symbols, but not as hard
         // rig up the counding so that 1 excluded -> 1 final count
@@ -255,26 +494,13 @@ Followset_Stats context_Get_Followset_Stats_With_Given_Symbols_Excluded(   Conte
         stats.total_count  = 0;
         stats.escape_count = CONTEXT_EXCLUDED_ESCAPE_INIT;
 
-        for (n = self->followset;   n;   n = n->next) {
-
-            if (excluded_symbols_Contains( excl, n->symbol ) ) {
-
-                if (n->count <= CONTEXT_SYMBOL_INC_NOVEL) {
-                    stats.escape_count += CONTEXT_EXCLUDED_ESCAPE_EXCLUDEDINC;
-                }
-
-            } else {
-
-                stats.total_count += n->count;
-
-                if (n->count > stats.max_count) {
-                    stats.max_count = n->count;
-                }
-
-                if (n->count <= CONTEXT_SYMBOL_INC_NOVEL) {
-                    stats.escape_count += CONTEXT_EXCLUDED_ESCAPE_INC;
-                }
-            }
+        if (self->followset_array) {
+            Followset_Array* array = self->followset_array;
+            int i;
+            for (i = 0;   i < self->followset_size;   ++i)   tally( &stats, excl, array->symbol[i], array->count[i] );
+        } else {
+            Followset_Node* n;
+            for (n = self->followset;   n;   n = n->next)   tally( &stats, excl, n->symbol, n->count );
         }
 
         stats.escape_count >>= CONTEXT_EXCLUDED_ESCAPE_SHIFT;
@@ -286,30 +512,60 @@ Followset_Stats context_Get_Followset_Stats_With_Given_Symbols_Excluded(   Conte
 // If a symbol of count < Novel is excluded, should we subtract from the escape?
 // I think not, since DONT_SEE_EXCLUDED failed
 
+static inline bool escaped(   Context* self   ) {
+
+    /* The symbol being coded is never excluded, so */
+    /* if 'self' escapes it cannot be in our set:   */
+    memo.absent |= 1U << self->order;
+    return FALSE;
+}
+
 bool context_Encode(   Context* self,   Arith* arith,   Excluded_Symbols* excl,   See* see,   u32 key,   int symbol   ) {
 
     assert( ! excluded_symbols_Contains( excl, symbol ) );
 
-    if (self->total_symbol_count == 0)   return FALSE;
+    if (self->total_symbol_count == 0)   return escaped( self );
 
     assert( self->total_symbol_count > 0 );
 
     {   Followset_Stats stats = context_Get_Followset_Stats_With_Given_Symbols_Excluded( self, excl );
 
-        if (stats.total_count == 0)   return FALSE;   /* No chars unexcluded. */
+        if (stats.total_count == 0)   return escaped( self );   /* No chars unexcluded. */
 
         {   int low  = 0;
             int high = 0;
-            Followset_Node* n;
-            for (n = self->followset;   n;   n = n->next) {
-                assert( n->count > 0 );
+            if (self->followset_array) {
+
+                /* Here the bitmap tells us whether to look at */
+                /* all, we can stop looking once we find it,   */
+                /* and we exclude the whole set in one go:     */
+                Followset_Array* array = self->followset_array;
+                if (is_present( array, symbol )) {
+                    int i;
+                    for (i = 0;   ;   ++i) {
+                        int s = array->symbol[i];
+                        assert( i < self->followset_size   &&   array->count[i] > 0 );
+
+                        if (excluded_symbols_Contains( excl, s ) )   continue;
+
+                        if (s == symbol)   {   high = low + array->count[i];   memo.coded_index = i;   break;   }   /* Found it! */ 
+                        low += array->count[i];
+                    }
+                }
+                excluded_symbols_Add_All( excl, array->present );
+            } else {
+                Followset_Node*  n;
+                Followset_Node** last;
+                for (last = &self->followset;   n = *last;   last = &n->next) {
+                    assert( n->count > 0 );
 
-                if (!excluded_symbols_Contains( excl, n->symbol ) ) {
+                    if (!excluded_symbols_Contains( excl, n->symbol ) ) {
 
-                    if (n->symbol == symbol) {   high = low + n->count;   }   /* Found it! */ 
-                    else if (high == 0)      {   low += n->count;         }
+                        if (n->symbol == symbol) {   high = low + n->count;   memo.coded_last = last;   }   /* Found it! */ 
+                        else if (high == 0)      {   low += n->count;         }
 
-                    excluded_symbols_Add( excl, n->symbol );
+                        excluded_symbols_Add( excl, n->symbol );
+                    }
                 }
             }
 
@@ -323,10 +579,11 @@ bool context_Encode(   Context* self,   Arith* arith,   Excluded_Symbols* excl,
                     /* Found it: */
                     see_Encode_Escape( see, arith, ss, stats.escape_count, stats.total_count, FALSE );
                     arith_Encode_1_Of_N( arith, low, high, stats.total_count );
+                    memo.coded_context = self;
                     return TRUE;
                 } else {
                     see_Encode_Escape( see, arith, ss, stats.escape_count, stats.total_count, TRUE );
-                    return FALSE;
+                    return escaped( self );
                 }
             }
         }
@@ -335,11 +592,11 @@ bool context_Encode(   Context* self,   Arith* arith,   Excluded_Symbols* excl,
 
 bool context_Decode(   Context* self,   Arith* arith,   Excluded_Symbols* excl,   See* see,   u32 key,   int* psymbol   ) {
 
-    if (self->total_symbol_count == 0)    return FALSE;
+    if (self->total_symbol_count == 0)    return escaped( self );
 
     {   Followset_Stats stats = context_Get_Followset_Stats_With_Given_Symbols_Excluded( self, excl );
 
-        if (stats.total_count == 0)   return FALSE;   /* No chars unexcluded. */
+        if (stats.total_count == 0)   return escaped( self );   /* No chars unexcluded. */
 
         {   See_State *ss;
 
@@ -347,19 +604,41 @@ bool context_Decode(   Context* self,   Arith* arith,   Excluded_Symbols* excl,
             else                                    ss = see_Get_State( see, stats.escape_count, stats.total_count, key, self );
 
             if (see_Decode_Escape( see, arith, ss, stats.escape_count, stats.total_count ) )	{
-                Followset_Node* n;
-                for (n = self->followset;   n;   n = n->next) {
-                    excluded_symbols_Add( excl, n->symbol );
+                if (self->followset_array) {
+                    excluded_symbols_Add_All( excl, self->followset_array->present );
+                } else {
+                    Followset_Node* n;
+                    for (n = self->followset;   n;   n = n->next)   excluded_symbols_Add( excl, n->symbol );
                 }
-                return FALSE;
+                return escaped( self );
             }
 
 //            assert( stats.total_count < arith->prob_max );
 
             {   int got = arith_Get_1_Of_N( arith, stats.total_count );
                 int low = 0;
-                Followset_Node* n;
-                for (n = self->followset;   n;   n = n->next) {
+                Followset_Node*  n;
+                Followset_Node** last;
+                if (self->followset_array) {
+                    Followset_Array* array = self->followset_array;
+                    int i;
+                    for (i = 0;   i < self->followset_size;   ++i) {
+                        assert( got >= low );
+                        if (!excluded_symbols_Contains( excl, array->symbol[i] )) {
+                            int high = low + array->count[i];
+                            if (got < high) {
+                                /* Found it: */
+                                arith_Decode_1_Of_N( arith, low, high, stats.total_count );
+                                *psymbol = array->symbol[i];
+                                memo.coded_context = self;
+                                memo.coded_index   = i;
+                                return TRUE;
+                            }
+                            low = high;
+                        }
+                    }
+                }
+                for (last = &self->followset;   n = *last;   last = &n->next) {
                     assert( got >= low );
                     if (!excluded_symbols_Contains( excl, n->symbol )) {
                         int high = low + n->count;
@@ -367,6 +646,8 @@ bool context_Decode(   Context* self,   Arith* arith,   Excluded_Symbols* excl,
                             /* Found it: */
                             arith_Decode_1_Of_N( arith, low, high, stats.total_count );
                             *psymbol = n->symbol;
+                            memo.coded_context = self;
+                            memo.coded_last    = last;
                             return TRUE;
                         }
                         low = high;
@@ -382,18 +663,57 @@ bool context_Decode(   Context* self,   Arith* arith,   Excluded_Symbols* excl,
 }
 
 
-Trie* trie_Create( void ) {
+Trie* trie_Create( bool defer_contexts ) {
 
     Trie* trie = new( Trie );
 
+    trie_Reset( trie, defer_contexts );
+
+    return trie;
+}
+
+void trie_Reset( Trie* trie, bool defer_contexts ) {
+
+    /*************************************************************/
+    /* Start over with an empty model.  Everything the old one   */
+    /* had -- Contexts, Followset_Nodes, hashtables -- lives in  */
+    /* arenas we simply rewind, keeping their memory mapped for  */
+    /* the next file rather than freeing it Context by Context.  */
+    /*************************************************************/
+
     Suffix suffix;    suffix._0_to_7.u_64 = 0;    suffix._8_to_F.u_64 = 0;
 
-    trie->order0 = context_create( suffix, 0 );
+    trie->lru_context_count = 0;
+#ifdef NORMAL
+    trie->max_lru_contexts  = (PZIP_TRIE_MEGS /* == 72 */ * 1024 * 1024) / sizeof( Context );
+#else
+    /* Made constant to avoid annoying irrevant fluctuations in compression ratio: */
+    trie->max_lru_contexts  = 1348169;
+#endif
+
+    /* Room for the LRU-managed Contexts plus */
+    /* those of order 0 and 1, which are not: */
+    if (!trie->context_arena) {
+        trie->context_arena_size = trie->max_lru_contexts + 1 + 256;
+        trie->context_arena      = huge_Calloc( trie->context_arena_size * sizeof( Context ) );
+    }
+    trie->context_arena_used = 0;
+    trie->free_contexts      = NULL;
+
+    if (trie->context_node_pool)   pool_Reset( trie->context_node_pool );
+    trie->context_node_pool_count = 0;
+
+    if (trie->followset_array_pool)   pool_Reset( trie->followset_array_pool );
+    else                              trie->followset_array_pool = pool_Create( sizeof( Followset_Array ), 1024, 1024, FALSE );
+
+    hash_Create( trie->context_arena, trie->context_arena_size );
+
+    trie->order0 = context_create( trie, suffix, 0 );
 
     {   uint i;
         for (i = 256;   i --> 0;   ) {
             suffix._0_to_7.u_64 = i;
-            trie->order1[i] = context_create( suffix, /*order==*/1 );
+            trie->order1[i] = context_create( trie, suffix, /*order==*/1 );
             trie->order1[i]->parent = trie->order0;
             ++trie->order0->kids;  /* Not strictly necessary, but consistent. */
         }
@@ -401,21 +721,30 @@ Trie* trie_Create( void ) {
 
     node_Init( &trie->least_recently_used );
 
-    trie->lru_context_count = 0;
-#ifdef NORMAL
-    trie->max_lru_contexts  = (PZIP_TRIE_MEGS /* == 72 */ * 1024 * 1024) / sizeof( Context );
-#else
-    /* Made constant to avoid annoying irrevant fluctuations in compression ratio: */
-    trie->max_lru_contexts  = 1348169;
-#endif
+    trie->last_sighting = NULL;
+    trie->revived_from  = NULL;
 
-    return trie;
+    if (!defer_contexts) {
+        huge_Free( trie->seen_suffixes );
+        trie->seen_suffixes = NULL;
+    } else if (trie->seen_suffixes) {
+        memset( trie->seen_suffixes, 0, TRIE_SEEN_SLOTS * sizeof( Seen_Bucket ) );
+    } else {
+        trie->seen_suffixes = huge_Calloc( TRIE_SEEN_SLOTS * sizeof( Seen_Bucket ) );
+    }
 }
 
 void trie_Destroy( Trie* trie ) {
 
-    /* Note that context_Destroy_All_Contexts recycles all our  */
-    /* Context instances en masse, so we don't need to do that: */
+    huge_Free( trie->seen_suffixes );
+
+    /* Everything lives in our arenas, so we free */
+    /* it en masse rather than Context by Context: */
+    pool_Auto_Destroy( &trie->context_node_pool, &trie->context_node_pool_count );
+    pool_Destroy( trie->followset_array_pool );
+    hash_Destroy();
+    huge_Free( trie->context_arena );
+
     destroy( trie );
 }
 
@@ -453,11 +782,17 @@ static void context_delete(   Context* self   ) {
         Followset_Node* next;
         for (symbols = self->followset;   symbols;   symbols = next) {
             next = symbols->next;
-            pool_Auto_Free_Hunk(   &context_node_pool,   &context_node_pool_count,   symbols   );
+            pool_Auto_Free_Hunk(   &trie->context_node_pool,   &trie->context_node_pool_count,   symbols   );
         }
     }
-        
-    pool_Auto_Free_Hunk( &pool, &pool_count, self );
+    if (self->followset_array)   pool_Free_Hunk( trie->followset_array_pool, self->followset_array );
+
+    /* Look-ahead hints may still point here, so make */
+    /* sure hash_Context_Matches() rejects us:        */
+    self->order = -1;
+
+    self->parent        = trie->free_contexts;
+    trie->free_contexts = self;
 
     -- trie->lru_context_count;
 }
@@ -479,7 +814,7 @@ static inline Context* mark_new_context_as_most_recently_used(   Context* contex
         
         Node* list = (Node*)&trie->least_recently_used;
         Node* node = list->prev;
-        Context* to_die = (Context*)( (u32)node - (u32)(&((Context*)0)->least_recently_used) );
+        Context* to_die = (Context*)( (u08*)node - (u08*)(&((Context*)0)->least_recently_used) );
         assert( node != list );
         /* Only kill leafs, because that avoids */
         /* the problem of leaving dangling      */
@@ -498,13 +833,136 @@ static inline Context* mark_new_context_as_most_recently_used(   Context* contex
 }
 
 static Context* create_kid(   Context* parent,   Suffix suffix   ) {
-    Context* newkid = context_create( suffix, parent->order +1 );
+    Context* newkid = context_create( trie, suffix, parent->order +1 );
     newkid->parent = parent;
     ++parent->kids;
     return mark_new_context_as_most_recently_used(   newkid   );
 }
 
-void trie_Fill_Active_Contexts(   u08* input_so_far   ) {
+static inline void compute_suffixes(   u08* input_so_far,   Suffix suffix[ PZIP_ORDER +1 ]   ) {
+
+    /* Pack the last 2..16 bytes of input into the */
+    /* keys used to index our order 2..8 Contexts: */
+
+    /* A local synonym and cast for code clarity: */
+    #undef  history
+    #define history (u64)input_so_far
+
+    suffix[2]._0_to_7.u_16 = (history[ -1 ] << 0x00) | (history[ -2 ] << 0x08);
+    suffix[3]._0_to_7.u_32 = suffix[2]._0_to_7.u_16  | (history[ -3 ] << 0x10);
+    suffix[4]._0_to_7.u_32 = suffix[3]._0_to_7.u_32  | (history[ -4 ] << 0x18);
+    suffix[5]._0_to_7.u_64 = suffix[4]._0_to_7.u_32  | (history[ -5 ] << 0x20);
+    suffix[6]._0_to_7.u_64 = suffix[5]._0_to_7.u_64  | (history[ -6 ] << 0x28)
+                                                     | (history[ -7 ] << 0x30)
+                                                     | (history[ -8 ] << 0x38);
+    suffix[7]._0_to_7.u_64 = suffix[6]._0_to_7.u_64;
+    suffix[8]._0_to_7.u_64 = suffix[7]._0_to_7.u_64;
+                                          
+                                          
+    suffix[7]._8_to_F.u_32 =  (history[ -9 ] << 0x00)
+                           |  (history[-10 ] << 0x08)
+                           |  (history[-11 ] << 0x10)
+                           |  (history[-12 ] << 0x18);
+    suffix[8]._8_to_F.u_64 =  suffix[7]._8_to_F.u_32
+                           |  (history[-13 ] << 0x20)
+                           |  (history[-14 ] << 0x28)
+                           |  (history[-15 ] << 0x30)
+                           |  (history[-16 ] << 0x38);
+    #undef  history
+}
+
+static const int suffix_bytes[ PZIP_ORDER +1 ] = { 0, 1, 2, 3, 4, 5, 8, 12, 16 };
+
+static inline u64 seen_suffix_hash(   int order,   Suffix* suffix   ) {
+
+    /* Hash the valid bytes of 'suffix' (see       */
+    /* compute_suffixes() -- the rest is garbage), */
+    /* mixed with 'order' so that equal bytes at   */
+    /* different orders land in different slots:   */
+    u64 lo;
+    u64 hi = 0;
+    switch (order) {
+    case 2:   lo = suffix->_0_to_7.u_16;                                       break;
+    case 3:
+    case 4:   lo = suffix->_0_to_7.u_32;                                       break;
+    case 5:
+    case 6:   lo = suffix->_0_to_7.u_64;                                       break;
+    case 7:   lo = suffix->_0_to_7.u_64;   hi = suffix->_8_to_F.u_32;          break;
+    default:  lo = suffix->_0_to_7.u_64;   hi = suffix->_8_to_F.u_64;          break;
+    }
+    lo ^= (hi + order) * 0x9E3779B97F4A7C15ULL;
+    lo ^= lo >> 29;
+    lo *= 0xBF58476D1CE4E5B9ULL;
+    lo ^= lo >> 32;
+    return lo;
+}
+
+static void note_sighting(   int order,   u08* input_so_far,   Suffix* suffix   ) {
+
+    /* Remember that the order 'order' suffix ends at  */
+    /* 'input_so_far', in place of its old sighting if */
+    /* the bucket has one, else of the oldest sighting */
+    /* there.  Positions only ever grow, so 'oldest'   */
+    /* is just 'lowest', with empty ways lowest of all: */
+    u64          hash   = seen_suffix_hash( order, suffix );
+    Seen_Bucket* bucket = &trie->seen_suffixes[ hash >> (64 - TRIE_SEEN_SHIFT) ];
+    u16          tag    = (u16)hash;
+    int          len    = suffix_bytes[ order ];
+    int          way;
+    int          oldest = 0;
+
+    for (way = 0;   way < TRIE_SEEN_WAYS;   ++way) {
+        u08* then = bucket->at[ way ];
+        if (then   &&   bucket->tag[ way ] == tag   &&   !memcmp( then - len, input_so_far - len, len )) {
+            oldest = way;
+            break;
+        }
+        if (then < bucket->at[ oldest ])   oldest = way;
+    }
+    bucket->at[  oldest ] = input_so_far;
+    bucket->tag[ oldest ] = tag;
+}
+
+static bool first_sighting(   int order,   u08* input_so_far,   Suffix suffix[ PZIP_ORDER +1 ]   ) {
+
+    /*************************************************/
+    /* Return TRUE iff the order 'order' suffix has  */
+    /* not been seen before, in which case we will   */
+    /* not be creating it or any higher-order        */
+    /* Context this time, so record all of them as   */
+    /* seen here.  A way remembers where its suffix  */
+    /* last ended in the input, so we can check the  */
+    /* bytes themselves rather than trust the hash.  */
+    /* Only a suffix pushed out of a full bucket by  */
+    /* six newer ones is seen for the first time all */
+    /* over again.                                   */
+    /*************************************************/
+
+    u64          hash   = seen_suffix_hash( order, &suffix[ order ] );
+    Seen_Bucket* bucket = &trie->seen_suffixes[ hash >> (64 - TRIE_SEEN_SHIFT) ];
+    u16          tag    = (u16)hash;
+    int          len    = suffix_bytes[ order ];
+    int          way;
+
+    for (way = 0;   way < TRIE_SEEN_WAYS;   ++way) {
+        u08* then = bucket->at[ way ];
+        if (then   &&   bucket->tag[ way ] == tag   &&   !memcmp( then - len, input_so_far - len, len )) {
+            trie->last_sighting = then;
+            return FALSE;
+        }
+    }
+
+    for (;   order <= PZIP_ORDER;   ++order) {
+        note_sighting( order, input_so_far, &suffix[ order ] );
+    }
+    return TRUE;
+}
+
+void trie_Get_Suffixes(   u08* input_so_far,   Suffix suffix[ PZIP_ORDER +1 ]   ) {
+    compute_suffixes( input_so_far, suffix );
+}
+
+bool trie_Fill_Active_Contexts(   u08* input_so_far,   Context* hint[ PZIP_ORDER +1 ]   ) {
 
     /*****************************************/
     /* As we compress the file byte by byte, */
@@ -541,35 +999,20 @@ void trie_Fill_Active_Contexts(   u08* input_so_far   ) {
     /*****************************************/
      
 
-    /* A local synonym and cast for code clarity: */
-    #undef  history
-    #define history (u64)input_so_far
+    /* If 'hint' is non-NULL, it holds candidate     */
+    /* Contexts for each order found in advance by   */
+    /* the look-ahead thread (lookahead.c).  They    */
+    /* may have been recycled since, so we check     */
+    /* them before use.  We return TRUE iff a hint   */
+    /* let us skip the search.                       */
 
     Suffix suffix[ PZIP_ORDER +1 ];
+    bool   hinted = FALSE;
+    int    deferred_order;
 
+    compute_suffixes( input_so_far, suffix );
 
-
-    suffix[2]._0_to_7.u_16 = (history[ -1 ] << 0x00) | (history[ -2 ] << 0x08);
-    suffix[3]._0_to_7.u_32 = suffix[2]._0_to_7.u_16  | (history[ -3 ] << 0x10);
-    suffix[4]._0_to_7.u_32 = suffix[3]._0_to_7.u_32  | (history[ -4 ] << 0x18);
-    suffix[5]._0_to_7.u_64 = suffix[4]._0_to_7.u_32  | (history[ -5 ] << 0x20);
-    suffix[6]._0_to_7.u_64 = suffix[5]._0_to_7.u_64  | (history[ -6 ] << 0x28)
-                                                     | (history[ -7 ] << 0x30)
-                                                     | (history[ -8 ] << 0x38);
-    suffix[7]._0_to_7.u_64 = suffix[6]._0_to_7.u_64;
-    suffix[8]._0_to_7.u_64 = suffix[7]._0_to_7.u_64;
-                                          
-                                          
-    suffix[7]._8_to_F.u_32 =  (history[ -9 ] << 0x00)
-                           |  (history[-10 ] << 0x08)
-                           |  (history[-11 ] << 0x10)
-                           |  (history[-12 ] << 0x18);
-    suffix[8]._8_to_F.u_64 =  suffix[7]._8_to_F.u_32
-                           |  (history[-13 ] << 0x20)
-                           |  (history[-14 ] << 0x28)
-                           |  (history[-15 ] << 0x30)
-                           |  (history[-16 ] << 0x38);
-    #undef  history
+    trie->revived_from = NULL;
 
     /* Finding the right order0 Context is easy, since */
     /* there's only one. :)  Finding the right order1  */
@@ -618,6 +1061,30 @@ void trie_Fill_Active_Contexts(   u08* input_so_far   ) {
         /* average.  Working out that idea logically produces the following code: */
         /**************************************************************************/
 
+        /* Phase zero:  If the look-ahead thread  */
+        /* already found a deep Context which is  */
+        /* still live, its ancestors are all the  */
+        /* lower-order active Contexts, so we can */
+        /* resume the search just below it:       */
+        if (hint) {
+            int k;
+            for (k = PZIP_ORDER;   k >= 5;   --k) {
+                if (hint[k] && hash_Context_Matches( hint[k], k, suffix[k] ))   break;
+            }
+            if (k >= 5) {
+                int j;
+                for (a[j = k] = hint[k];   j > 2;   --j)   a[j-1] = a[j]->parent;
+                assert( a[2]->parent == a[1] );
+                hinted = TRUE;
+                switch (k) {
+                case 8:    goto done;
+                case 7:    goto probe8;
+                case 6:    goto probe7;
+                default:   goto tag;
+                }
+            }
+        }
+
         /* Phase one:  Find all the pre-existing */
         /* nodes along our active-contexts path: */
         if       (a[5] = hash_Find_Context_05( suffix[5] )) {   a[4] = a[5]->parent;   a[3] = a[4]->parent;   a[2] = a[3]->parent;   goto tag;   }
@@ -626,19 +1093,24 @@ void trie_Fill_Active_Contexts(   u08* input_so_far   ) {
         else if  (a[2] = hash_Find_Context_02( suffix[2] )) {                                                                        goto three; }
         goto two;
 tag:    if (!a[5]->kids)   goto six;     if (!(a[6] = hash_Find_Context_08( suffix[6] )))   goto six;     
-        if (!a[6]->kids)   goto seven;   if (!(a[7] = hash_Find_Context_12( suffix[7] )))   goto seven;   
-        if (!a[7]->kids)   goto eight;   if (!(a[8] = hash_Find_Context_16( suffix[8] )))   goto eight;   
+probe7: if (!a[6]->kids)   goto seven;   if (!(a[7] = hash_Find_Context_12( suffix[7] )))   goto seven;   
+probe8: if (!a[7]->kids)   goto eight;   if (!(a[8] = hash_Find_Context_16( suffix[8] )))   goto eight;   
         goto done;
 
         /* Phase two: Create all the missing     */
-        /* nodes along our active-contexts path: */
-two:    a[2] = create_kid( a[1], suffix[2] );
-three:  a[3] = create_kid( a[2], suffix[3] );
-four:   a[4] = create_kid( a[3], suffix[4] );
-five:   a[5] = create_kid( a[4], suffix[5] );
-six:    a[6] = create_kid( a[5], suffix[6] );
-seven:  a[7] = create_kid( a[6], suffix[7] );
-eight:  a[8] = create_kid( a[7], suffix[8] );
+        /* nodes along our active-contexts path, */
+        /* unless we are deferring them:         */
+        #undef  deferred
+        #define deferred(o) (trie->seen_suffixes   &&   (o) >= CONTEXT_DEFER_MIN_ORDER   &&   first_sighting( deferred_order = (o), input_so_far, suffix ))
+two:                                            a[2] = create_kid( a[1], suffix[2] );
+three:  if (deferred( 3 ))   goto partial;      a[3] = create_kid( a[2], suffix[3] );
+four:   if (deferred( 4 ))   goto partial;      a[4] = create_kid( a[3], suffix[4] );
+five:   if (deferred( 5 ))   goto partial;      a[5] = create_kid( a[4], suffix[5] );
+six:    if (deferred( 6 ))   goto partial;      a[6] = create_kid( a[5], suffix[6] );
+seven:  if (deferred( 7 ))   goto partial;      a[7] = create_kid( a[6], suffix[7] );
+eight:  if (deferred( 8 ))   goto partial;      a[8] = create_kid( a[7], suffix[8] );
+        if (trie->seen_suffixes)   trie->revived_from = trie->last_sighting;
+        #undef  deferred
 
         /* Phase three: Mark all the active      */
         /* contexts as recently used;            */
@@ -653,9 +1125,22 @@ done:   mark_as_most_recently_used( a[2] );
         /* Now -that- is what I call "block-structured programming" :)      */
         /* That's also most of the 'goto's for my last 20 years od hacking. */
         /* But it speeded up pzip by 4% when switched on.                   */
+        goto marked;
+
+        /* Phase three, deferred version:  Contexts */
+        /* of order 'deferred_order' and up do not  */
+        /* exist yet, so leave their slots empty:   */
+partial:
+        {   int o;
+            for (o = 2;   o < deferred_order;   ++o)   mark_as_most_recently_used( a[o] );
+            for (     ;   o <= PZIP_ORDER;      ++o)   a[o] = NULL;
+        }
+marked: ;
     }                                                       
 
     #endif /* THE_SIMPLE_TEXTBOOK_WAY */
 
     #undef a
+
+    return hinted;
 }
@@ -15,7 +15,9 @@ typedef struct Context Context;
 #define DEFINED_CONTEXT
 #endif
 
-typedef struct Followset_Node Followset_Node;
+typedef struct Followset_Node  Followset_Node;
+typedef struct Followset_Array Followset_Array;
+typedef struct Seen_Bucket     Seen_Bucket;       /* Private to context.c. */
 
 /***
 
@@ -120,6 +122,15 @@ typedef struct Followset_Node Followset_Node;
 /* Followset_Nodes, each containing fields for the    */
 /* symbol, its appearance count, and a 'next' pointer. */      
 /*                                                     */
+/* Walking that list misses cache at every node, which */
+/* is ruinous for the few big follow sets of orders 0  */
+/* to 2 that we scan on nearly every symbol, so once a */
+/* set reaches CONTEXT_ARRAY_MIN_SYMBOLS symbols we    */
+/* move it into a Followset_Array instead, and set     */
+/* 'followset' to NULL.  The array keeps the same      */
+/* symbols and counts in the same order, so the coding */
+/* is exactly as before.                               */
+/*                                                     */
 /* To save time recomputing, we also maintain some     */
 /* summary statistics of the follow set:               */
 /*                                                     */
@@ -158,8 +169,27 @@ typedef struct Followset_Node Followset_Node;
 /* in order-1.[ch], and not explicitly dealt with in this module. */
 /*                                                                */
 /* If/when we run out of space for new Contexts, we recycle the   */
-/* least-recently used Context:  The last three fields in the     */
-/* Trie provide the state to support this.                        */
+/* least-recently used Context:  The 'least_recently_used' fields */
+/* in the Trie provide the state to support this.                 */
+/*                                                                */
+/* The Trie owns all the memory its Contexts and their follow     */
+/* sets live in:  One array of Contexts, sized to hold every      */
+/* Context we can have live at once, and Pools of Followset_Nodes */
+/* and Followset_Arrays.  trie_Reset() rewinds them all without   */
+/* unmapping anything, and trie_Destroy() frees them.             */
+/*                                                                */
+/* Most high-order Contexts are seen exactly once and then just   */
+/* wait to be recycled.  If created with 'defer_contexts', the    */
+/* Trie instead materializes a missing Context of order           */
+/* CONTEXT_DEFER_MIN_ORDER or more only on the second sighting of */
+/* its suffix, remembering where each suffix was last seen in the */
+/* hashed table 'seen_suffixes'.  Until then the slots for it and */
+/* all higher orders in active_contexts are NULL.  When the last  */
+/* trie_Fill_Active_Contexts() call created the order PZIP_ORDER  */
+/* Context, 'revived_from' is where it was first seen, so that    */
+/* the deterministic model can catch up (deterministic_Seed()).   */
+/* This changes the model, so it is recorded in the file header   */
+/* (PZIP_OPTION_DEFER_CONTEXTS).                                  */
 /******************************************************************/
 
 struct Trie {
@@ -169,6 +199,19 @@ struct Trie {
     Node      least_recently_used;
     uint      lru_context_count;
     uint      max_lru_contexts;
+
+    Context*  context_arena;            /* Every Context, freed or not.                       */
+    uint      context_arena_used;       /* Slots of it handed out since trie_Reset().         */
+    uint      context_arena_size;
+    Context*  free_contexts;            /* Recycled ones, chained through their 'parent's.    */
+
+    Pool*     context_node_pool;        /* Followset_Nodes.                                   */
+    int       context_node_pool_count;
+    Pool*     followset_array_pool;     /* Followset_Arrays.                                  */
+
+    Seen_Bucket* seen_suffixes;         /* Hashed sightings, non-NULL iff deferring creation. */
+    u08*      last_sighting;            /* Set by first_sighting() when it returns FALSE.     */
+    u08*      revived_from;             /* See below.                                         */
 };
 typedef struct Trie Trie;
 
@@ -182,6 +225,17 @@ struct Followset_Node {
     u16           count;     /* Number of times symbol has been  */
 };                             /* seen in this context.            */
 
+/* Or for a big set, side by side, most recently */
+/* seen first just as in the list, along with a  */
+/* bitmap of the symbols present, laid out like  */
+/* Excluded_Symbols so we can exclude them all   */
+/* at once:                                      */
+struct Followset_Array {
+    u64           present[ 4 ];
+    u08           symbol[ 256 ];
+    u16           count[  256 ];
+};
+
 typedef union {
     u64 u_64;
     u32 u_32;
@@ -198,15 +252,14 @@ typedef struct Suffix Suffix;
 struct Context {
 
     int      order;                     /* Length of 'parent' pointerchain.             */
-
-    Context* parent;                   
     int      kids;
 
-    Context* hashlink;                  /* Implements hash table chaining.              */
+    Context* parent;                   
 
     Suffix   suffix;
 
     Followset_Node* followset;          /* One node for every symbol in follow set.     */ 
+    Followset_Array* followset_array;   /* Instead of 'followset' for a big set.        */
     int             followset_size;     /* Number of symbols in the followset           */
     int             total_symbol_count; /* Sum of all symbol's counts.                  */
     int             max_count;          /* Max of all 'follow->count's.                 */
@@ -226,9 +279,8 @@ typedef struct {
     int escape_count;  /* Roughly: Number of novel symbols seen in this context. */
 } Followset_Stats;
 
-void     context_Destroy_All_Contexts( void );       /* Global & naughty, but oh-so-fast */
-
 void     context_Update(   Context* self,   int symbol,   u32 key,   See* see,   int coded_order  );
+void     context_Update_Active_Contexts(   int symbol,   u32 key,   See* see,   int coded_order  );
 
 Followset_Stats context_Get_Followset_Stats_With_Given_Symbols_Excluded(   Context* self,   Excluded_Symbols* excl   );
 
@@ -242,13 +294,17 @@ typedef struct {
 } Contexts;
 extern Contexts active_contexts;
 
-/* There's only one Trie, so just publish it: */
+/* The Trie of the model being coded with.  pzip.c   */
+/* owns it;  we publish it so that the per-symbol    */
+/* calls here needn't all pass it around:            */
 extern Trie* trie;
 
-Trie* trie_Create( void );
+Trie* trie_Create( bool defer_contexts );
 
 void trie_Destroy(                Trie* self );
-void trie_Fill_Active_Contexts(   u08* input_ptr   );
+void trie_Reset(                  Trie* self,   bool defer_contexts   );   /* Empty, for the next file. */
+bool trie_Fill_Active_Contexts(   u08* input_ptr,   Context* hint[ PZIP_ORDER +1 ]   );
+void trie_Get_Suffixes(           u08* input_ptr,   Suffix suffix[ PZIP_ORDER +1 ]   );
 
 Context* context_Is_Most_Recently_Used( Context* context );
 
@@ -1,4 +1,10 @@
 #include "inc.h"
+#include "crc32.h"
+
+#if defined( __GNUC__ ) && defined( __x86_64__ )
+#define CRC32_PCLMUL
+#include <immintrin.h>
+#endif
 
 static u32 crc_table[256] = {
     0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419,
@@ -55,6 +61,11 @@ static u32 crc_table[256] = {
     0x2D02EF8D
 };
 
+/* crc_slice[k][b] is the CRC of byte 'b' followed by 'k' zero */
+/* bytes, so that we can step eight bytes at a time, and        */
+/* crc_slice[0] is just crc_table.  Filled in by choose():      */
+static u32 crc_slice[ 8 ][ 256 ];
+
 #define STEPCRC(crc,byte) (crc) = crc_table[((int)(crc) ^ (byte)) & 0xff] ^ ((crc) >> 8)
 
 /* Note: A CRC is not a checksum, but many people use the */
@@ -63,10 +74,10 @@ static u32 crc_table[256] = {
 /* pedantic precision in our name here.                   */
 /*   A name is not a definition!                          */
 
-u32 crc32_Compute_Checksum( const u08* buf, int buflen ) {
-    u32 crc = ~(u32)0;
+/* Each implementation below takes and returns the CRC */
+/* register itself, that is, before the final invert:  */
 
-    if (!buf)   return 0;
+static u32 bytewise(   u32 crc,   const u08* buf,   int buflen   ) {
 
     while (buflen & 0xF) {
         STEPCRC( crc, *buf );
@@ -98,8 +109,156 @@ u32 crc32_Compute_Checksum( const u08* buf, int buflen ) {
         STEPCRC( crc, *buf );  buf++;
     }
 
-    crc ^= 0xFFFFFFFF;
+    return crc;
+}
+
+static u32 sliced(   u32 crc,   const u08* buf,   int buflen   ) {
+
+    /* "Slicing by 8":  Eight independent table lookups */
+    /* per eight bytes, rather than a chain of eight.   */
+    /* (Like the rest of pzip, assumes little-endian.)  */
+
+    while (buflen >= 8) {
+        u32 lo;
+        u32 hi;
+        memcpy( &lo, buf,    4 );
+        memcpy( &hi, buf +4, 4 );
+        lo ^= crc;
+        crc = crc_slice[7][  lo        & 0xff ]
+            ^ crc_slice[6][ (lo >>  8) & 0xff ]
+            ^ crc_slice[5][ (lo >> 16) & 0xff ]
+            ^ crc_slice[4][  lo >> 24         ]
+            ^ crc_slice[3][  hi        & 0xff ]
+            ^ crc_slice[2][ (hi >>  8) & 0xff ]
+            ^ crc_slice[1][ (hi >> 16) & 0xff ]
+            ^ crc_slice[0][  hi >> 24         ];
+        buf    += 8;
+        buflen -= 8;
+    }
+
+    while (buflen--) {
+        STEPCRC( crc, *buf );
+        buf++;
+    }
 
     return crc;
 }
 
+#ifdef CRC32_PCLMUL
+
+/*****************************************************************/
+/* Carry-less multiply folding, after Gopal et al., "Fast CRC    */
+/* Computation for Generic Polynomials Using PCLMULQDQ           */
+/* Instruction" (Intel, 2009):  Four 128-bit lanes are folded    */
+/* forward 64 bytes at a time, then into one lane, which a       */
+/* Barrett reduction takes down to 32 bits.  The constants are   */
+/* x^k mod P(x) for the bit-reflected CRC-32 polynomial.         */
+/*****************************************************************/
+
+static const u64 fold_by_4[ 2 ] __attribute__(( aligned( 16 ) )) = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+static const u64 fold_by_1[ 2 ] __attribute__(( aligned( 16 ) )) = { 0x01751997d0ULL, 0x00ccaa009eULL };
+static const u64 fold_64[   2 ] __attribute__(( aligned( 16 ) )) = { 0x0163cd6124ULL, 0x0000000000ULL };
+static const u64 barrett[   2 ] __attribute__(( aligned( 16 ) )) = { 0x01db710641ULL, 0x01f7011641ULL };
+
+#define FOLD(x,k,y)   _mm_xor_si128( _mm_xor_si128( _mm_clmulepi64_si128( (x), (k), 0x11 ), _mm_clmulepi64_si128( (x), (k), 0x00 ) ), (y) )
+
+__attribute__(( target( "pclmul,sse2" ) ))
+static u32 folded(   u32 crc,   const u08* buf,   int buflen   ) {
+
+    __m128i x1, x2, x3, x4, k, mask;
+
+    if (buflen < 64)   return sliced( crc, buf, buflen );
+
+    x1 = _mm_loadu_si128( (const __m128i*)(buf + 0x00) );
+    x2 = _mm_loadu_si128( (const __m128i*)(buf + 0x10) );
+    x3 = _mm_loadu_si128( (const __m128i*)(buf + 0x20) );
+    x4 = _mm_loadu_si128( (const __m128i*)(buf + 0x30) );
+    x1 = _mm_xor_si128( x1, _mm_cvtsi32_si128( crc ) );
+    buf    += 64;
+    buflen -= 64;
+
+    k = _mm_load_si128( (const __m128i*)fold_by_4 );
+    while (buflen >= 64) {
+        x1 = FOLD( x1, k, _mm_loadu_si128( (const __m128i*)(buf + 0x00) ) );
+        x2 = FOLD( x2, k, _mm_loadu_si128( (const __m128i*)(buf + 0x10) ) );
+        x3 = FOLD( x3, k, _mm_loadu_si128( (const __m128i*)(buf + 0x20) ) );
+        x4 = FOLD( x4, k, _mm_loadu_si128( (const __m128i*)(buf + 0x30) ) );
+        buf    += 64;
+        buflen -= 64;
+    }
+
+    k  = _mm_load_si128( (const __m128i*)fold_by_1 );
+    x1 = FOLD( x1, k, x2 );
+    x1 = FOLD( x1, k, x3 );
+    x1 = FOLD( x1, k, x4 );
+    while (buflen >= 16) {
+        x1 = FOLD( x1, k, _mm_loadu_si128( (const __m128i*)buf ) );
+        buf    += 16;
+        buflen -= 16;
+    }
+
+    /* 128 bits down to 64: */
+    mask = _mm_setr_epi32( ~0, 0, ~0, 0 );
+    x2   = _mm_clmulepi64_si128( x1, k, 0x10 );
+    x1   = _mm_xor_si128( _mm_srli_si128( x1, 8 ), x2 );
+
+    k    = _mm_loadl_epi64( (const __m128i*)fold_64 );
+    x2   = _mm_srli_si128( x1, 4 );
+    x1   = _mm_clmulepi64_si128( _mm_and_si128( x1, mask ), k, 0x00 );
+    x1   = _mm_xor_si128( x1, x2 );
+
+    /* Barrett reduction down to 32: */
+    k    = _mm_load_si128( (const __m128i*)barrett );
+    x2   = _mm_clmulepi64_si128( _mm_and_si128( x1, mask ), k, 0x10 );
+    x2   = _mm_clmulepi64_si128( _mm_and_si128( x2, mask ), k, 0x00 );
+    x1   = _mm_xor_si128( x1, x2 );
+
+    crc  = _mm_cvtsi128_si32( _mm_srli_si128( x1, 4 ) );
+
+    return sliced( crc, buf, buflen );
+}
+
+#undef FOLD
+
+#endif /* CRC32_PCLMUL */
+
+static u32 choose( u32 crc, const u08* buf, int buflen );
+
+/* The implementation to use, picked on first call: */
+static u32 (*update)( u32 crc, const u08* buf, int buflen ) = choose;
+
+static u32 choose(   u32 crc,   const u08* buf,   int buflen   ) {
+
+    int b, k;
+    for (b = 0;   b < 256;   ++b) {
+        u32 c = crc_table[ b ];
+        crc_slice[0][ b ] = c;
+        for (k = 1;   k < 8;   ++k) {
+            c = crc_table[ c & 0xff ] ^ (c >> 8);
+            crc_slice[k][ b ] = c;
+        }
+    }
+
+    update = sliced;
+#ifdef CRC32_PCLMUL
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports( "pclmul" ))   update = folded;
+#endif
+
+    return update( crc, buf, buflen );
+}
+
+u32 crc32_Update(   u32 crc,   const u08* buf,   int buflen   ) {
+    if (!buf)   return crc;
+    return ~update( ~crc, buf, buflen );
+}
+
+u32 crc32_Compute_Checksum( const u08* buf, int buflen ) {
+    if (!buf)   return 0;
+    return crc32_Update( 0, buf, buflen );
+}
+
+u32 crc32_Compute_Checksum_Bytewise( const u08* buf, int buflen ) {
+    if (!buf)   return 0;
+    return ~bytewise( ~(u32)0, buf, buflen );
+}
@@ -3,4 +3,12 @@
 
 extern u32 crc32_Compute_Checksum( const u08* buf, int buflen );
 
+/* For data arriving piecemeal:  Start with crc == 0, and pass */
+/* each result back in with the next piece.  The final result  */
+/* is the same as crc32_Compute_Checksum() over all of it:     */
+extern u32 crc32_Update( u32 crc, const u08* buf, int buflen );
+
+/* The original byte-at-a-time version, for reference: */
+extern u32 crc32_Compute_Checksum_Bytewise( const u08* buf, int buflen );
+
 #endif /* CRC32_H */
@@ -77,6 +77,13 @@ Escape* escape_Create( void ) {
         }
     }
 
+    escape_Reset( self );
+
+    return self;
+}
+
+void escape_Reset(   Escape* self   ) {
+
     /* Seed each partition's bins with our best a priori */
     /* guesses as to their escape probabilities:         */
     {   int      i, j;
@@ -95,8 +102,6 @@ Escape* escape_Create( void ) {
             }
         }
     }
-
-    return self;
 }
 
 void escape_Destroy(   Escape* self   ) {
@@ -216,6 +221,11 @@ static X pick_bins(   u32 key,   int escape_count,   int total_symbols_count,
     return x;
 }
 
+static inline int weight(   int entropy   ) {
+    /* (1 << 16) / entropy, without dividing in the usual case: */
+    return (entropy > 0)   ?   (int) intdiv( 1 << 16, entropy )   :   (1 << 16) / entropy;
+}
+
 /* Define a little local synonym */
 /* for 'intlog2r' to make the    */
 /* code read better:             */
@@ -263,20 +273,22 @@ static X estimated_escape_probability(   Escape* self,   u32 key,   int escape_c
         int e2 = self->esc[2][ x.bin[2] ];   int t2 = self->tot[2][ x.bin[2] ];
 
         /* Compute relative weights for the three predictions: */
-        int w0 = (1 << 16) / (t0 * log2(t0) - e0 * log2(e0) - (t0-e0) * log2(t0-e0) + 1);
-        int w1 = (1 << 16) / (t1 * log2(t1) - e1 * log2(e1) - (t1-e1) * log2(t1-e1) + 1);
-        int w2 = (1 << 16) / (t2 * log2(t2) - e2 * log2(e2) - (t2-e2) * log2(t2-e2) + 1);
+        int w0 = weight( t0 * log2(t0) - e0 * log2(e0) - (t0-e0) * log2(t0-e0) + 1 );
+        int w1 = weight( t1 * log2(t1) - e1 * log2(e1) - (t1-e1) * log2(t1-e1) + 1 );
+        int w2 = weight( t2 * log2(t2) - e2 * log2(e2) - (t2-e2) * log2(t2-e2) + 1 );
 
         /* Combine to produce our final prediction: */
         x.total_count  = w0*t0 + w1*t1 + w2*t2;
         x.escape_count = w0*e0 + w1*e1 + w2*e2;
 
         /* Scale our final answer to avoid overflow */
-        /* in the arithmetic encoder:               */
-        while (x.total_count >=  1 << 13+8) {  x.total_count  >>= 8;    x.escape_count >>= 8;        }
-        if    (x.total_count >=  1 << 13+4) {  x.total_count  >>= 4;    x.escape_count >>= 4;        }
-        if    (x.total_count >=  1 << 13+2) {  x.total_count  >>= 2;    x.escape_count >>= 2;        }
-        if    (x.total_count >=  1 << 13+1) {  x.total_count  >>= 1;    x.escape_count >>= 1;        }
+        /* in the arithmetic encoder:  Shifting it  */
+        /* just below 1 << 14 is what the old       */
+        /* 8,4,2,1 cascade of shifts amounted to.   */
+        {   int shift = intshift_below( x.total_count, 14 );
+            x.total_count  >>= shift;
+            x.escape_count >>= shift;
+        }
 
         /* If our prediction is insane -- change it! :) */
         if (x.escape_count < 1) {
@@ -7,6 +7,7 @@ typedef struct Escape Escape;
 
 Escape* escape_Create(  void         );
 void    escape_Destroy( Escape* self );
+void    escape_Reset(   Escape* self );
 void escape_Encode(     Escape* self,   Arith* arith,   u32 key,   int escC,   int totC,   int sym_count,   bool escape );
 bool escape_Decode(     Escape* self,   Arith* arith,   u32 key,   int escP,   int totP,   int sym_count                );
 
@@ -39,8 +39,8 @@
 #include "inc.h"
 #include "pool.h"
 #include "intmath.h"
-#include "node.h"
 #include "config.h"
+#include "huge.h"
 
 /*******
 
@@ -49,9 +49,13 @@
  *********/
 
 #define DETERMINISTIC_MAX_MATCH_LEN      (1024)
+#define DETERMINISTIC_MAX_MIN_LEN        (DETERMINISTIC_MAX_MATCH_LEN + 12)   /* Longest longest_common_suffix(). */
 #define DETERMINISTIC_MAX_NODES_TO_VISIT  (100)
+#define DETERMINISTIC_MAX_CHAIN_PROBES     (32)
+#define DETERMINISTIC_SURE_MATCH_LEN       (64)
+#define DETERMINISTIC_RUN_BINS              (8)
 
-#define NODE_ARRAY_SIZE           (1<<18)             /* A 256k window. */
+#define CHAIN_HASH_BITS (20)
 
 #define DO_ADDNODE_ON_SUCCESS
 
@@ -73,41 +77,99 @@
 /* We count Deterministic_Context matches and escapes        */
 /* much as we do for regular Context instances.              */
 /*                                                           */
-/* In addition, we maintain (via 'node') a doubly linked     */
+/* In addition, we maintain (via 'newest') a linked list     */
 /* of our complete family of 12-byte-suffix-related          */
-/* "deterministic" contexts, one Deterministic_Node each.    */
+/* "deterministic" contexts, one Deterministic_Node each,    */
+/* newest first.                                             */
 /*                                                           */
-/* Each Deterministic_Node contains a pointer to the spot in */
-/* the input buffer at which it ends ('input_ptr'), and the  */
-/* minimum length of suffix match needed to make its         */
-/* prediction unique -- "deterministic" -- ("min_len").      */
+/* Each Deterministic_Node contains the offset in the input  */
+/* buffer at which it ends ('input_pos'), and the minimum    */
+/* length of suffix match needed to make its prediction      */
+/* unique -- "deterministic" -- ("min_len").                 */
 /*                                                           */
 /* The prediction of each such node is of course available   */
-/* as *node->input_ptr: The byte following it in the input.  */
+/* as input_buf[ node->input_pos ]: The byte following it in */
+/* the input.                                                */
+/*************************************************************/
+
+/*************************************************************/
+/* Deterministic_Nodes live in a ring of 2**window_bits of   */
+/* them, which is how far back in the input we can find      */
+/* matches.  The window is a model parameter recorded in the */
+/* file header (PZIP_OPTION_DET_WINDOW) and may run to tens  */
+/* of megabytes, so nodes are kept small:  They refer to     */
+/* each other by 'serial', the count of nodes allocated up   */
+/* to and including them, rather than by pointer.  Node      */
+/* 'serial' sits in node[ serial & window_mask ] until the   */
+/* ring comes round again, so it is still there iff          */
+/* self->serial - serial <= window_mask.  Lists run from new */
+/* to old, so the first node found overwritten ends a list;  */
+/* nothing need ever be unlinked, and a reset just zeroes    */
+/* self->serial.                                             */
+/*************************************************************/
+
+/*************************************************************/
+/* A Deterministic_Context's list holds every position with  */
+/* its suffix, most of which match too briefly to qualify    */
+/* (min_len is never under DETERMINISTIC_MIN_ORDER), and a   */
+/* hot context's list runs past the 100 nodes we visit.  So  */
+/* with PZIP_OPTION_DET_CHAINS we instead walk a hash chain  */
+/* of all positions whose preceding DETERMINISTIC_MIN_ORDER  */
+/* bytes hash alike:  'head' by hash, then 'chain' in each   */
+/* node, newest first like the lists.  Every position which  */
+/* can qualify is on our chain, so a few probes find the     */
+/* longest match.                                            */
+/*************************************************************/
+
+/*************************************************************/
+/* Once a match runs to DETERMINISTIC_SURE_MATCH_LEN we code */
+/* each further byte of it at a fraction of a bit, yet each  */
+/* still costs a full trip through the Trie, SEE and our own */
+/* node lists.  With PZIP_OPTION_MATCH_RUNS we instead go    */
+/* into a "run":  While it lasts, pzip.c codes each byte via */
+/* deterministic_Run_Encode() alone, which just follows the  */
+/* match ('run_pos') and codes hit or escape as one bit,     */
+/* from counts kept by log2 of match length.  Nothing else   */
+/* sees the run's bytes, so the Trie gets no Contexts and we */
+/* get no nodes for them.  The first miss ends the run:      */
+/* That symbol then goes through the full model as usual,    */
+/* with our deterministic_Encode() merely excluding the      */
+/* failed prediction, and the next match is found afresh.    */
 /*************************************************************/
 
 
 struct Deterministic_Context {
-    Node node;                /* All Deterministic_Nodes of this context, doubly linked. */
+    u32  newest;              /* Serial of our latest Deterministic_Node, else 0.   */
     uint matches_seen;
     uint escapes_seen;
 };
 
 struct Deterministic_Node {
-    Node   node;              /* Must be at head! */
-    u16  min_len;           /* Match must be at least this long to be unique. */
-    u08* input_ptr;
+    u32  input_pos;           /* Offset into input_buf at which we end.             */
+    u32  older;               /* Serial of next older node of our context, else 0.  */
+    u32  chain;               /* Serial of next older node with our hash, else 0.   */
+    u32  min_len;             /* Match must be at least this long to be unique.     */
 };
 
 struct Det {
     Pool*    deterministic_context_pool;
     Escape*  escape;
 
-    Deterministic_Node node[ NODE_ARRAY_SIZE +1 ];
-    uint     node_cursor;
+    Deterministic_Node* node;           /* The ring;  see above. */
+    uint     window_bits;
+    u32      window_mask;
+    u32      serial;                    /* Of the latest node allocated, 0 if none yet. */
+    u32*     head;                      /* Hash chains if PZIP_OPTION_DET_CHAINS, else NULL. */
 
     Deterministic_Node*    next_node;
 
+    /* Match runs, if PZIP_OPTION_MATCH_RUNS;  see above: */
+    bool     match_runs;
+    u32      run_pos;                   /* Offset into input_buf of next prediction, 0 if no run. */
+    int      run_missed;                /* Prediction which just ended the run, else -1.          */
+    u16      run_escapes[ DETERMINISTIC_RUN_BINS ];
+    u16      run_total[   DETERMINISTIC_RUN_BINS ];
+
     /* Stuff saved by Encode/Decode for Update. (Ick!!) */
     Deterministic_Context* cached_deterministic_context;
     Deterministic_Node*    cached_node;
@@ -116,20 +178,61 @@ struct Det {
 };
 
 
-Det* deterministic_Create( void ) {
+Det* deterministic_Create(   uint window_bits,   bool hash_chains,   bool match_runs   ) {
 
     Det* self = new( Det );
 
-    self->deterministic_context_pool = pool_Create( sizeof( Deterministic_Context ), 100*1024, 100*256 );
+    self->deterministic_context_pool = pool_Create( sizeof( Deterministic_Context ), 100*1024, 100*256, FALSE );
 
     self->escape      = escape_Create();
-    self->node_cursor = 0;
 
+    deterministic_Reset( self, window_bits, hash_chains, match_runs );
+
+    return self;
+}
+
+void deterministic_Reset(   Det* self,   uint window_bits,   bool hash_chains,   bool match_runs   ) {
+
+    /* Forget everything, keeping our memory */
+    /* unless our parameters have changed:   */
+
+    pool_Reset(   self->deterministic_context_pool   );
+    escape_Reset( self->escape                       );
+
+    if (window_bits != self->window_bits) {
+        huge_Free( self->node );
+        self->node        = huge_Calloc( sizeof( Deterministic_Node ) << window_bits );
+        self->window_bits = window_bits;
+        self->window_mask = (1U << window_bits) -1;
+    }
+    self->serial = 0;
+
+    if (!hash_chains) {
+        huge_Free( self->head );
+        self->head = NULL;
+    } else if (!self->head) {
+        self->head = huge_Calloc( sizeof( u32 ) << CHAIN_HASH_BITS );
+    } else {
+        /* Stale heads would pass for live ones once */
+        /* self->serial caught up with them:         */
+        memset( self->head, 0, sizeof( u32 ) << CHAIN_HASH_BITS );
+    }
+
+    self->match_runs                   = match_runs;
+    self->run_pos                      = 0;
+    self->run_missed                   = -1;
     {   int  i;
-        for (i = NODE_ARRAY_SIZE;   i --> 0;)   node_Init( &self->node[i] );
+        for (i = 0;   i < DETERMINISTIC_RUN_BINS;   ++i) {
+            self->run_escapes[i] =  1;
+            self->run_total[i]   = 64;
+        }
     }
 
-    return self;
+    self->next_node                    = NULL;
+    self->cached_deterministic_context = NULL;
+    self->cached_node                  = NULL;
+    self->cached_match_len             = 0;
+    self->longest_match_len            = 0;
 }
 
 void deterministic_Destroy(   Det* self   ) {
@@ -137,24 +240,39 @@ void deterministic_Destroy(   Det* self   ) {
 
     pool_Destroy(     self->deterministic_context_pool   );
     escape_Destroy(   self->escape                       );
+    huge_Free(        self->node                         );
+    huge_Free(        self->head                         );
     destroy(          self                               );
 }
 
+static inline Deterministic_Node* node_with_serial(   Det* self,   u32 serial   ) {
+
+    /* NULL if none or overwritten: */
+    if (!serial || self->serial - serial > self->window_mask)   return NULL;
+    return &self->node[ serial & self->window_mask ];
+}
+
 static Deterministic_Node* alloc_deterministic_node(   Det* self   ) {
-    Deterministic_Node* node = &self->node[ self->node_cursor++ ];
-    if (self->node_cursor == NODE_ARRAY_SIZE) {
-        self->node_cursor = 0;
-    }
-    node_Cut( node );
-    return    node;
+    return &self->node[ ++self->serial & self->window_mask ];
 }
 
 static Deterministic_Node* next_deterministic_node(   Det* self,   Deterministic_Node* node   ) {
-    ++node;
-    if (node == &self->node[ NODE_ARRAY_SIZE ]) {
-        node  = &self->node[               0 ];
+
+    /* The node allocated just after 'node', if any yet: */
+    u32 serial = self->serial - ((self->serial - (u32)(node - self->node)) & self->window_mask);
+    return (serial == self->serial)   ?   NULL   :   node_with_serial( self, serial +1 );
+}
+
+static inline u32 chain_hash(   u08* input_ptr   ) {
+
+    /* Hash the DETERMINISTIC_MIN_ORDER (24) bytes */
+    /* before input_ptr, independent of byte order: */
+    u32  hash = 0;
+    uint i;
+    for (i = DETERMINISTIC_MIN_ORDER;   i;   i -= 4) {
+        hash = (hash ^ getu32( input_ptr - i )) * 0x9E3779B1;
     }
-    return node;
+    return hash >> (32 - CHAIN_HASH_BITS);
 }
 
 static Deterministic_Context* fetch_or_make_deterministic_context(   Det* det,   Context* context   ) {
@@ -172,26 +290,34 @@ static Deterministic_Context* fetch_or_make_deterministic_context(   Det* det,
         Deterministic_Context* dc = pool_Get_Hunk( det->deterministic_context_pool );
         dc->escapes_seen  = 1;
         dc->matches_seen  = 1;
-        node_Init( &dc->node );
+        dc->newest        = 0;
         context->det = dc;
         return dc;
     }
 }
 
-static Deterministic_Node* add_node_to_context(   Det* self,   Context* context,   u08* input_ptr,   uint min_len   ) {
+static Deterministic_Node* add_node_to_context(   Det* self,   Context* context,   u08* input_ptr,   u08* input_buf,   uint min_len   ) {
 
     Deterministic_Context* dc   = fetch_or_make_deterministic_context( self, context );
     Deterministic_Node*    node = alloc_deterministic_node( self );
 
-    node_Add( &dc->node, node );
+    node->older     = dc->newest;
+    dc->newest      = self->serial;
+
+    if (self->head) {
+        u32* head   = &self->head[ chain_hash( input_ptr ) ];
+        node->chain = *head;
+        *head       = self->serial;
+    }
 
     node->min_len   = max( min_len, DETERMINISTIC_MIN_ORDER /* == 24 */ );
-    node->input_ptr = input_ptr;
+    node->min_len   = min( node->min_len, DETERMINISTIC_MAX_MIN_LEN );
+    node->input_pos = input_ptr - input_buf;
 
     return node;
 }
 
-void deterministic_Update(   Det* self,   u08* input_ptr,   int symbol,   Context* context   ) {
+void deterministic_Update(   Det* self,   u08* input_ptr,   u08* input_buf,   int symbol,   Context* context   ) {
 
     /* We get called on each char */
     /* in the file in succession. */
@@ -202,7 +328,7 @@ void deterministic_Update(   Det* self,   u08* input_ptr,   int symbol,   Contex
     if (node) {
         assert( self->cached_deterministic_context );
 
-        if (*node->input_ptr == symbol) {
+        if (input_buf[ node->input_pos ] == symbol) {
 
             ++ self->cached_deterministic_context->matches_seen;
 
@@ -212,17 +338,45 @@ void deterministic_Update(   Det* self,   u08* input_ptr,   int symbol,   Contex
             /* to boot:                                */
             self->next_node = next_deterministic_node( self, node );
 
+            /* That relies on our having added a node  */
+            /* for every input position, which is not  */
+            /* so when the Trie is deferring Contexts: */
+            if (self->next_node
+            &&  self->next_node->input_pos != node->input_pos +1
+            ){
+                self->next_node = NULL;
+            }
+
+            /* Sure enough to hand over to a run? */
+            if (self->match_runs && self->cached_match_len >= DETERMINISTIC_SURE_MATCH_LEN) {
+                self->run_pos            = node->input_pos +1;
+                self->next_node          = NULL;
+                self->cached_node        = NULL;
+            }
+
         } else {
 
             ++ self->cached_deterministic_context->escapes_seen;
 
             assert( self->cached_match_len >= node->min_len );
 
-            node->min_len = self->cached_match_len + DETERMINISTIC_MIN_LEN_INC /* == 2 */;
+            /* No longer a match than longest_common_suffix() */
+            /* can report, else this node could never match  */
+            /* again once next_node stops carrying it:       */
+            node->min_len = min( self->cached_match_len + DETERMINISTIC_MIN_LEN_INC /* == 2 */,   DETERMINISTIC_MAX_MIN_LEN );
         }
     }
 
-    add_node_to_context( self, context, input_ptr, self->longest_match_len +1 );
+    /* NULL if the Trie deferred creating it: */
+    if (context)   add_node_to_context( self, context, input_ptr, input_buf, self->longest_match_len +1 );
+}
+
+void deterministic_Seed(   Det* self,   u08* input_ptr,   u08* input_buf,   Context* context   ) {
+
+    /* The Trie deferred creating 'context' when it */
+    /* was first seen, at 'input_ptr', so we missed */
+    /* that deterministic_Update();  make up for it: */
+    add_node_to_context( self, context, input_ptr, input_buf, DETERMINISTIC_MIN_ORDER );
 }
 
 static int longest_common_suffix(   u08* p,   u08* q,   u08* input_buf   ) {
@@ -249,13 +403,38 @@ static int longest_common_suffix(   u08* p,   u08* q,   u08* input_buf   ) {
     {   int len     = 0;
         int max_len = min(   p - input_buf,   q - input_buf   );
         max_len     = min(   max_len,   DETERMINISTIC_MAX_MATCH_LEN /* == 1024 */ );
-        while (*p-- == *q--) {
+
+#if defined( __GNUC__ ) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        /***************************************************/
+        /* Compare eight bytes at a time while that stays  */
+        /* clear of max_len, hence of input_buf's start.   */
+        /* The highest-addressed byte which differs is the */
+        /* most significant nonzero byte of their XOR:     */
+        /***************************************************/
+        while (len + 8 < max_len) {
+            u64 a;
+            u64 b;
+            memcpy( &a, p - len - 7, 8 );
+            memcpy( &b, q - len - 7, 8 );
+            if (a != b)   return len + (__builtin_clzll( a ^ b ) >> 3) + 12;
+            len += 8;
+        }
+#endif
+        while (p[ -len ] == q[ -len ]) {
             if (++len >= max_len)   break;
         }
         return len + 12;   /* Count the 12 known-to-match bytes too! */
     }
 }
 
+static inline Deterministic_Node* first_candidate(   Det* self,   Deterministic_Context* dc,   u08* input_ptr   ) {
+    return node_with_serial( self, self->head   ?   self->head[ chain_hash( input_ptr ) ]   :   dc->newest );
+}
+
+static inline Deterministic_Node* next_candidate(   Det* self,   Deterministic_Node* node   ) {
+    return node_with_serial( self, self->head   ?   node->chain   :   node->older );
+}
+
 static void  find_best_node(   Det* self,   Deterministic_Context* dc,   u08* input_ptr,   u08* input_buf   ) {
 
     if (!dc) {
@@ -283,10 +462,20 @@ static void  find_best_node(   Det* self,   Deterministic_Context* dc,   u08* in
         uint                longest_len = 0;
 
         uint nodes_visited = 0;
+        uint max_visits    = self->head   ?   DETERMINISTIC_MAX_CHAIN_PROBES   :   DETERMINISTIC_MAX_NODES_TO_VISIT;
         Deterministic_Node* node;
-        for (node = node_Next(&dc->node);   node != (Deterministic_Node*)&dc->node;   node = node_Next(node)) {
+        for (node = first_candidate( self, dc, input_ptr );   node;   node = next_candidate( self, node )) {
+
+            u08* match = input_buf + node->input_pos;
+            uint len;
 
-            uint len = longest_common_suffix(   input_ptr,   node->input_ptr,   input_buf   );
+            /* longest_common_suffix() trusts the last 12 bytes */
+            /* to match, which a hash chain doesn't promise:    */
+            if (self->head && memcmp( input_ptr - 12, match - 12, 12 )) {
+                len = 0;
+            } else {
+                len = longest_common_suffix(   input_ptr,   match,   input_buf   );
+            }
 
             longest_len = max( longest_len, len );
 
@@ -298,7 +487,10 @@ static void  find_best_node(   Det* self,   Deterministic_Context* dc,   u08* in
             }
 
             /* Take out some insurance against pathological cases: */
-            if (++nodes_visited == DETERMINISTIC_MAX_NODES_TO_VISIT /* == 100 */)   break;
+            if (++nodes_visited == max_visits)   break;
+
+            /* Nothing can beat a match that long: */
+            if (best_len == DETERMINISTIC_MAX_MATCH_LEN + 12)   break;
         }
 
         self->cached_deterministic_context = dc;
@@ -311,22 +503,44 @@ static void  find_best_node(   Det* self,   Deterministic_Context* dc,   u08* in
     }
 }
 
+static inline Deterministic_Context* context_det(   Det* self,   Context* context   ) {
+
+    /*************************************************************/
+    /* The Deterministic_Context of 'context', else NULL.  With  */
+    /* hash chains, the positions we can match live in the ring  */
+    /* and 'head', not in the Deterministic_Context, and so      */
+    /* outlive the Trie recycling its Context:  Give a Context   */
+    /* made afresh a Deterministic_Context at once, so that we   */
+    /* can still find all of the window and not only what the    */
+    /* Trie still holds.                                         */
+    /*************************************************************/
+
+    if (!self->head)   return context->det;
+    return fetch_or_make_deterministic_context( self, context );
+}
+
 static void find_match(   Det* self,   u08* input_ptr,   u08* input_buf,   Context* context   ) {
 
-    if (!self->next_node) {
+    if (!context) {
+
+        /* The Trie deferred creating it, so */
+        /* there can be no nodes to match:   */
+        find_best_node( self, NULL, input_ptr, input_buf );
+
+    } else if (!self->next_node) {
 
         self->cached_deterministic_context = NULL;
         self->cached_node                  = NULL;
 
-        find_best_node(   self,   context->det,   input_ptr,   input_buf   );
+        find_best_node(   self,   context_det( self, context ),   input_ptr,   input_buf   );
 
     } else {
 
-        self->cached_deterministic_context = context->det;
+        self->cached_deterministic_context = context_det( self, context );
 
         if (!self->cached_deterministic_context) {
 
-            find_best_node( self, context->det, input_ptr, input_buf );
+            find_best_node( self, NULL, input_ptr, input_buf );
 
         } else {
 
@@ -334,7 +548,7 @@ static void find_match(   Det* self,   u08* input_ptr,   u08* input_buf,   Conte
             self->cached_match_len ++;
             self->longest_match_len = max(   self->longest_match_len,   self->cached_match_len   );
 
-            if (self->cached_match_len >= 64) {
+            if (self->cached_match_len >= DETERMINISTIC_SURE_MATCH_LEN) {
 
                 /* Force it to accept this match: */
                 self->cached_node->min_len = min(   self->cached_node->min_len,   self->cached_match_len   );
@@ -349,16 +563,31 @@ static void find_match(   Det* self,   u08* input_ptr,   u08* input_buf,   Conte
     }
 }
 
+static bool run_missed(   Det* self,   Excluded_Symbols* excl   ) {
+
+    /* deterministic_Run_Encode/Decode() already coded the */
+    /* escape from our prediction, so just exclude it:      */
+    if (self->run_missed < 0)   return FALSE;
+
+    excluded_symbols_Add( excl, self->run_missed );
+    self->run_missed                   = -1;
+    self->cached_deterministic_context = NULL;
+    self->cached_node                  = NULL;
+    return TRUE;
+}
+
 bool deterministic_Encode(   Det* self,   Arith* arith,   u08* input_ptr,   u08* input_buf,   int symbol,   Excluded_Symbols* excl,   Context* context   ) {
 
+    if (run_missed( self, excl ))   return FALSE;
+
     find_match( self, input_ptr, input_buf, context );
 
     if (!self->cached_node)   return FALSE;
 
     {   int  count      =  self->cached_deterministic_context->matches_seen;
-        int  prediction = *self->cached_node->input_ptr;
+        int  prediction = input_buf[ self->cached_node->input_pos ];
 
-        if (self->cached_match_len >= 64)   count = 99999;
+        if (self->cached_match_len >= DETERMINISTIC_SURE_MATCH_LEN)   count = 99999;
 
         assert( excluded_symbols_Is_Empty( excl ) );
 
@@ -376,15 +605,17 @@ bool deterministic_Encode(   Det* self,   Arith* arith,   u08* input_ptr,   u08*
 
 bool deterministic_Decode(   Det* self,   Arith* arith,   u08* input_ptr,   u08* input_buf,   int* psymbol,   Excluded_Symbols* excl,   Context* context   ) {
 
+    if (run_missed( self, excl ))   return FALSE;
+
     find_match( self, input_ptr, input_buf, context );
 
     if (!self->cached_node)   return FALSE;
 
 
     {   int  count  =  self->cached_deterministic_context->matches_seen;
-        int  symbol = *self->cached_node->input_ptr;
+        int  symbol = input_buf[ self->cached_node->input_pos ];
 
-        if (self->cached_match_len >= 64)   count = 99999;
+        if (self->cached_match_len >= DETERMINISTIC_SURE_MATCH_LEN)   count = 99999;
 
         assert( excluded_symbols_Is_Empty( excl ) );
 
@@ -398,3 +629,62 @@ bool deterministic_Decode(   Det* self,   Arith* arith,   u08* input_ptr,   u08*
         }
     }
 }
+
+static inline uint run_bin(   Det* self   ) {
+
+    /* log2 of match length, from DETERMINISTIC_SURE_MATCH_LEN up: */
+    uint bin = (31 - __builtin_clz( self->cached_match_len )) - 6;
+    return min( bin, DETERMINISTIC_RUN_BINS -1 );
+}
+
+static bool run_step(   Det* self,   uint bin,   int prediction,   bool match   ) {
+
+    /* Update our counts much as det_escape.c does: */
+    self->run_total[ bin ] += 17;
+    if (!match)   self->run_escapes[ bin ] += 17;
+    if (self->run_total[ bin ] > 16000) {
+        self->run_total[   bin ] >>= 1;
+        self->run_escapes[ bin ]   = max( self->run_escapes[ bin ] >> 1, 1 );
+    }
+
+    if (match) {
+        ++ self->run_pos;
+        ++ self->cached_match_len;
+        self->longest_match_len = max(   self->longest_match_len,   self->cached_match_len   );
+    } else {
+        self->run_pos    = 0;
+        self->run_missed = prediction;
+    }
+    return match;
+}
+
+bool deterministic_Run_Encode(   Det* self,   Arith* arith,   u08* input_ptr,   u08* input_buf,   int symbol   ) {
+
+    /* TRUE iff we coded 'symbol' as the next byte of a run. */
+    /* FALSE and no bits coded if there is no run on.        */
+
+    if (!self->run_pos)   return FALSE;
+
+    {   uint bin        = run_bin( self );
+        int  prediction = input_buf[ self->run_pos ];
+        bool match      = (symbol == prediction);
+
+        arith_Encode_Bit( arith, self->run_total[ bin ] - self->run_escapes[ bin ], self->run_total[ bin ], !match );
+
+        return run_step( self, bin, prediction, match );
+    }
+}
+
+bool deterministic_Run_Decode(   Det* self,   Arith* arith,   u08* input_ptr,   u08* input_buf,   int* psymbol   ) {
+
+    if (!self->run_pos)   return FALSE;
+
+    {   uint bin    = run_bin( self );
+        int  symbol = input_buf[ self->run_pos ];
+        bool match  = ! arith_Decode_Bit( arith, self->run_total[ bin ] - self->run_escapes[ bin ], self->run_total[ bin ] );
+
+        *psymbol = symbol;
+
+        return run_step( self, bin, symbol, match );
+    }
+}
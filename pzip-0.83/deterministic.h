@@ -12,12 +12,22 @@ typedef struct Deterministic_Context    Deterministic_Context;
 
 #include "context.h"
 
-Det* deterministic_Create( void );
+/* Matches reach back 2**window_bits symbols,  */
+/* found by hash chains if 'hash_chains'; long */
+/* ones become runs if 'match_runs':           */
+Det* deterministic_Create(   uint window_bits,   bool hash_chains,   bool match_runs   );
 
 void deterministic_Destroy(   Det* self   );
-void deterministic_Update(    Det* self,                     u08* input_ptr,                       int   symbol,                             Context* context );
+void deterministic_Reset(     Det* self,   uint window_bits,   bool hash_chains,   bool match_runs   );
+void deterministic_Update(    Det* self,                     u08* input_ptr,   u08* input_buf,   int   symbol,                             Context* context );
+void deterministic_Seed(      Det* self,                     u08* input_ptr,   u08* input_buf,                                           Context* context );
 bool deterministic_Encode(    Det* self,   Arith* arith,     u08* input_ptr,   u08* input_buf,   int   symbol,   Excluded_Symbols* excl,   Context* context );
 bool deterministic_Decode(    Det* self,   Arith* arith,     u08* input_ptr,   u08* input_buf,   int* psymbol,   Excluded_Symbols* excl,   Context* context );
 
+/* Code the next byte of a run without the rest of the model, */
+/* else FALSE.  See PZIP_OPTION_MATCH_RUNS in deterministic.c: */
+bool deterministic_Run_Encode( Det* self,   Arith* arith,     u08* input_ptr,   u08* input_buf,   int   symbol   );
+bool deterministic_Run_Decode( Det* self,   Arith* arith,     u08* input_ptr,   u08* input_buf,   int* psymbol   );
+
 #endif /* DETETERMINISTIC_H */
 
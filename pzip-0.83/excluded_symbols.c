@@ -3,16 +3,11 @@
 #include "safe.h"
 
 /* Excluded_Symbols keeps track of the set of currently excluded symbols */
-/* via an explicit 256-long array.                              */
+/* via a 256-bit bitmap, one bit per symbol.                    */
 /*                                                              */
-/* As a small trick to speed resetting the state to empty,      */
-/* we define an slot to be 'set' if it is equal to 'is_set',    */
-/* and empty otherwise:  This lets us empty the array in O(1)   */
-/* time by incrementing 'is_set' instead of in O(N) time by     */
-/* iterating over the array slots in the array.                 */
-/*                                                              */
-/* The fly in the ointment is that when 'is_set' wraps around   */
-/* to zero, we must do an honest O(N) clear of the array.       */
+/* Emptying it is just four stores, and being dense it lets     */
+/* order-1.c count and select unexcluded symbols a word at a    */
+/* time (with popcount) instead of a symbol at a time.          */
 /*                                                              */
 /* As a further speed optimization, we use 'is_empty' to tack   */
 /* whether the set is currently empty:  This lets us answer     */
@@ -20,25 +15,29 @@
 
 bool excluded_symbols_Is_Empty( Excluded_Symbols* e ){   return e->is_empty;   }
 
-static Excluded_Symbols* reset( Excluded_Symbols* e ) {
-    memset( e->symbol_set, 0, 256 );
-    e->is_set   = 1;
-    e->is_empty = TRUE;
-    return e;
-}
-
-Excluded_Symbols* excluded_symbols_Create( void )              {   return reset( new( Excluded_Symbols ) );            }
+Excluded_Symbols* excluded_symbols_Create( void )              {   Excluded_Symbols* e = new( Excluded_Symbols );   excluded_symbols_Clear( e );   return e;   }
 void excluded_symbols_Destroy( Excluded_Symbols* e )           {   destroy( e );                              }
-bool excluded_symbols_Contains( Excluded_Symbols* e, int sym ) {   return e->symbol_set[ sym ] == e->is_set;   }
+bool excluded_symbols_Contains( Excluded_Symbols* e, int sym ) {   return (e->bits[ sym >> 6 ] >> (sym & 63)) & 1;   }
 
 void excluded_symbols_Clear( Excluded_Symbols* e ) {
     e->is_empty = TRUE;
-    if (! ++e->is_set)   reset( e );
+    e->bits[0]  = 0;
+    e->bits[1]  = 0;
+    e->bits[2]  = 0;
+    e->bits[3]  = 0;
 }
 
 void excluded_symbols_Add(   Excluded_Symbols* e,   int sym   ) {
-    e->symbol_set[ sym ] = e->is_set;
+    e->bits[ sym >> 6 ] |= 1ULL << (sym & 63);
     e->is_empty          = FALSE;
 }
 
+void excluded_symbols_Add_All(   Excluded_Symbols* e,   u64 bits[ 4 ]   ) {
+    e->bits[0] |= bits[0];
+    e->bits[1] |= bits[1];
+    e->bits[2] |= bits[2];
+    e->bits[3] |= bits[3];
+    e->is_empty = e->is_empty && !(bits[0] | bits[1] | bits[2] | bits[3]);
+}
+
  
@@ -2,9 +2,8 @@
 #define EXCLUDE_H
 
 struct Excluded_Symbols {
-    uint   is_set;
     bool   is_empty;
-    uint   symbol_set[ 256 ];
+    u64    bits[ 4 ];       /* Bit (sym & 63) of bits[ sym >> 6 ] set iff 'sym' excluded. */
 };
 typedef struct Excluded_Symbols Excluded_Symbols;
 
@@ -12,12 +11,20 @@ extern Excluded_Symbols* excluded_symbols_Create( void );
 extern void     excluded_symbols_Destroy(  Excluded_Symbols* e );
 extern void     excluded_symbols_Clear(    Excluded_Symbols* e );
 extern void     excluded_symbols_Add(      Excluded_Symbols* e, int sym );
+extern void     excluded_symbols_Add_All(  Excluded_Symbols* e, u64 bits[ 4 ] );   /* Same bit layout as ours. */
 extern bool     excluded_symbols_Contains( Excluded_Symbols* e, int sym );
 extern bool     excluded_symbols_Is_Empty( Excluded_Symbols* e );
 
 #ifdef __GNUC__
-extern inline bool excluded_symbols_Contains( Excluded_Symbols* e, int sym ) {   return e->symbol_set[ sym ] == e->is_set;   }
+extern inline bool excluded_symbols_Contains( Excluded_Symbols* e, int sym ) {   return (e->bits[ sym >> 6 ] >> (sym & 63)) & 1;   }
+extern inline void excluded_symbols_Add(      Excluded_Symbols* e, int sym ) {   e->bits[ sym >> 6 ] |= 1ULL << (sym & 63);   e->is_empty = FALSE;   }
+extern inline void excluded_symbols_Add_All(  Excluded_Symbols* e, u64 bits[ 4 ] ) {
+    e->bits[0] |= bits[0];
+    e->bits[1] |= bits[1];
+    e->bits[2] |= bits[2];
+    e->bits[3] |= bits[3];
+    e->is_empty = e->is_empty && !(bits[0] | bits[1] | bits[2] | bits[3]);
+}
 #endif
 
 #endif
- 
@@ -1,17 +1,71 @@
 #include <stdio.h>
 #include "inc.h"
 #include "hash.h"
+#include "huge.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Orders 3 and up use open addressing in Hash_Buckets,  */
+/* each exactly one cache line.  A live Context may sit  */
+/* in any slot of its home bucket, or -- if that filled  */
+/* up -- of the buckets following it:                    */
+#define HASH_BUCKET_SLOTS (12)
+
+typedef struct {
+    u08 tag[ HASH_BUCKET_SLOTS ];       /* 0 == empty, else 8 bits of the hash.                  */
+    u32 displaced;                      /* Entries which passed through here, bucket being full. */
+    u32 index[ HASH_BUCKET_SLOTS ];     /* Context is contexts[ index ].                         */
+} Hash_Bucket;
+
+typedef char hash_bucket_size_check[ sizeof( Hash_Bucket ) == 64   ?   1   :   -1 ];
+
+/*****************************************************************/
+/* The tables start small and double whenever they get three     */
+/* quarters full, up to a size which can hold all the Contexts   */
+/* the Trie will ever have at once.  Rather than stall to copy   */
+/* the whole table, each doubling leaves the old table in 'old'  */
+/* and moves HASH_MIGRATE_STEP of its buckets across per insert; */
+/* until it is empty, lookups try both.                          */
+/*                                                               */
+/* The look-ahead thread may be probing a table at any moment,   */
+/* so outgrown Hash_Tables are only freed between files.         */
+/*****************************************************************/
+
+#define HASH_MIN_BUCKETS  (1 << 8)
+#define HASH_MIGRATE_STEP (2)
+
+typedef struct Hash_Table Hash_Table;
+struct Hash_Table {
+    Hash_Bucket* bucket;
+    uint         mask;                  /* Bucket count, minus one.             */
+    Hash_Table*  retired;               /* Next outgrown table, for cleanup.    */
+};
+
+typedef struct {
+    Hash_Table*  now;                   /* New Contexts go here.                */
+    Hash_Table*  old;                   /* Being emptied into 'now', else NULL. */
+    uint         migrated;              /* Buckets of 'old' emptied so far.     */
+    uint         count;                 /* Contexts in 'now' plus 'old'.        */
+    uint         max_mask;              /* Never grow past this.                */
+} Hash_Index;
+
+/* Indexed by order;  order 6 is 'hashtab_08' etc in the */
+/* names below, after the bytes of suffix they cover:    */
+static Hash_Index   hashtab[ PZIP_ORDER +1 ];
+static Hash_Table*  retired_tables = NULL;
+
+/* The Trie's array of all Contexts, from hash_Create(): */
+static Context*     contexts       = NULL;
 
 Context* hashtab_02[ HASH_SLOTS_02 ];
-Context* hashtab_03[ HASH_SLOTS_03 ];
-Context* hashtab_04[ HASH_SLOTS_04 ];
-Context* hashtab_05[ HASH_SLOTS_05 ];
-Context* hashtab_08[ HASH_SLOTS_08 ];
-Context* hashtab_12[ HASH_SLOTS_12 ];
-Context* hashtab_16[ HASH_SLOTS_16 ];
+u32      hashtab_02_dirty[ HASH_CHUNKS_02 / 32 ];
 
 void     hash_Note_Context_02(   Context* context,   Suffix suffix   ) {
-    hashtab_02[ suffix._0_to_7.u_16 ] = context;
+    uint i = suffix._0_to_7.u_16;
+    hashtab_02[ i ] = context;
+    hashtab_02_dirty[ i >> (HASH_CHUNK_BITS_02 + 5) ] |= 1u << ((i >> HASH_CHUNK_BITS_02) & 31);
 }
 
 void     hash_Drop_Context_02(   Context* context   ) {
@@ -22,319 +76,416 @@ Context* hash_Find_Context_02(   Suffix suffix   ) {
     return hashtab_02[ suffix._0_to_7.u_16 ];
 }
 
+static void clear_02(   void   ) {
 
+    uint w;
 
+    for (w = 0;   w < HASH_CHUNKS_02 / 32;   ++w) {
 
-void     hash_Note_Context_03(   Context* context,   Suffix suffix   ) {
+        u32 bits = hashtab_02_dirty[ w ];
 
-    u32 hash32 = suffix._0_to_7.u_32;
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_03;
-
-    context->hashlink = hashtab_03[ hash32 ];
-    hashtab_03[ hash32 ] = context;
-}
-
-void     hash_Drop_Context_03(   Context* context   ) {
-
-    Suffix suffix = context->suffix;
-    u32 hash32 = suffix._0_to_7.u_32;
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_03;
-
-    {   Context** patchpoint = &hashtab_03[ hash32 ];
-        Context*  c;
-        for (c = *patchpoint;   c;   patchpoint = &c->hashlink, c = *patchpoint) {
-            if (c->suffix._0_to_7.u_32 == suffix._0_to_7.u_32 ){
-                *patchpoint = c->hashlink;
-                return;  
-            }
+        while (bits) {
+            uint chunk = (w << 5) + __builtin_ctz( bits );
+            memset( &hashtab_02[ chunk << HASH_CHUNK_BITS_02 ], 0, sizeof( Context* ) << HASH_CHUNK_BITS_02 );
+            bits &= bits -1;
         }
+        hashtab_02_dirty[ w ] = 0;
     }
-    assert( 0 && "Attempt to drop Context not in hashtab_03[]" );
 }
 
-Context* hash_Find_Context_03(   Suffix suffix   ) {
+static Hash_Table* table_create(   uint buckets   ) {
+    Hash_Table* t = new( Hash_Table );
+    t->bucket     = huge_Calloc( buckets * sizeof( Hash_Bucket ) );
+    t->mask       = buckets -1;
+    return t;
+}
 
-    u32 hash32 = suffix._0_to_7.u_32;
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_03;
+static void retire(   Hash_Table* t   ) {
+    t->retired     = retired_tables;
+    retired_tables = t;
+}
 
-    {   Context* c;
-        for (c = hashtab_03[ hash32 ];   c;   c = c->hashlink) {
-            if (c->suffix._0_to_7.u_32 == suffix._0_to_7.u_32){
-                return c;
-            }
-        }
+static void free_retired(   void   ) {
+    while (retired_tables) {
+        Hash_Table* t  = retired_tables;
+        retired_tables = t->retired;
+        huge_Free( t->bucket );
+        destroy( t );
     }
-    return NULL;
 }
 
+void hash_Create(   Context* arena,   uint max_contexts   ) {
 
+    uint max_buckets = HASH_MIN_BUCKETS;
+    int  order;
 
+    contexts = arena;
 
-void     hash_Note_Context_04(   Context* context,   Suffix suffix   ) {
+    /* Leave ourselves an eighth to spare even if */
+    /* every Context were of the same order:      */
+    while (max_buckets * HASH_BUCKET_SLOTS < max_contexts + (max_contexts >> 3))   max_buckets <<= 1;
 
-    u32 hash32 = suffix._0_to_7.u_32;
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_04;
+    /* When starting over on a new file, keep the tables */
+    /* grown last time rather than hand their pages back */
+    /* to the kernel only to fault them in again.  The   */
+    /* look-ahead thread is not running between files,   */
+    /* so outgrown tables may be freed now.  A table is  */
+    /* only ever grown once three quarters full, so the  */
+    /* memset() is proportional to the most Contexts the */
+    /* last file had at once, not to max_contexts:       */
+    for (order = 3;   order <= PZIP_ORDER;   ++order) {
 
-    context->hashlink = hashtab_04[ hash32 ];
-    hashtab_04[ hash32 ] = context;
-}
+        Hash_Index* x    = &hashtab[ order ];
+        Hash_Table* keep = x->now;
 
-void     hash_Drop_Context_04(   Context* context   ) {
+        if (keep   &&   keep->mask >= max_buckets)   { retire( keep );   keep = NULL; }
+        if (x->old)                                    retire( x->old );
 
-    Suffix suffix = context->suffix;
+        if (keep)   memset( keep->bucket, 0, (keep->mask +1) * sizeof( Hash_Bucket ) );
+        else        keep = table_create( HASH_MIN_BUCKETS );
 
-    u32 hash32 = suffix._0_to_7.u_32;
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_04;
-
-    {   Context** patchpoint = &hashtab_04[ hash32 ];
-        Context*  c;
-        for (c = *patchpoint;   c;   patchpoint = &c->hashlink, c = *patchpoint) {
-            if (c->suffix._0_to_7.u_32 == suffix._0_to_7.u_32){
-                *patchpoint = c->hashlink;
-                return;  
-            }
-        }
+        memset( x, 0, sizeof( *x ) );
+        x->now      = keep;
+        x->max_mask = max_buckets -1;
     }
-    assert( 0 && "Attempt to drop Context not in hashtab_04[]" );
+    free_retired();
+    clear_02();
 }
 
-Context* hash_Find_Context_04(   Suffix suffix   ) {
+void hash_Destroy( void ) {
 
-    u32 hash32 = suffix._0_to_7.u_32;
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_04;
+    int order;
 
-    {   Context* c;
-        for (c = hashtab_04[ hash32 ];   c;   c = c->hashlink) {
-            if (c->suffix._0_to_7.u_32 == suffix._0_to_7.u_32){
-                return c;
-            }
-        }
+    for (order = 3;   order <= PZIP_ORDER;   ++order) {
+        Hash_Index* x = &hashtab[ order ];
+        if (x->now)   retire( x->now );
+        if (x->old)   retire( x->old );
+        memset( x, 0, sizeof( *x ) );
     }
-    return NULL;
+    free_retired();
+    clear_02();
+    contexts = NULL;
 }
 
+/* Only the low 'order'-dependent bytes of a Suffix are */
+/* valid (see compute_suffixes() in context.c), so we   */
+/* must hash and compare exactly those:                 */
 
+static inline u64 suffix_hash(   int order,   Suffix* suffix   ) {
 
+    u64 lo;
+    u64 hi = 0;
+    u64 h;
 
-void     hash_Note_Context_05(   Context* context,   Suffix suffix   ) {
-
-    u64 hash64 = suffix._0_to_7.u_64;
-    u32 hash32 = hash64 + (hash64 >> 32);
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_05;
+    switch (order) {
+    case 3:
+    case 4:   lo = suffix->_0_to_7.u_32;                                 break;
+    case 5:
+    case 6:   lo = suffix->_0_to_7.u_64;                                 break;
+    case 7:   lo = suffix->_0_to_7.u_64;   hi = suffix->_8_to_F.u_32;    break;
+    default:  lo = suffix->_0_to_7.u_64;   hi = suffix->_8_to_F.u_64;    break;
+    }
 
-    context->hashlink = hashtab_05[ hash32 ];
-    hashtab_05[ hash32 ] = context;
+    /* Multiply-xorshift, so every key bit reaches */
+    /* both the bucket bits (low) and tag (high):  */
+    h  = (lo ^ (hi * 0x9E3779B97F4A7C15ULL)) * 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 29;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 32;
+    return h;
 }
 
-void     hash_Drop_Context_05(   Context* context   ) {
+static inline bool same_suffix(   Context* c,   int order,   Suffix* suffix   ) {
 
-    Suffix suffix = context->suffix;
+    switch (order) {
+    case 3:
+    case 4:   return c->suffix._0_to_7.u_32 == suffix->_0_to_7.u_32;
+    case 5:
+    case 6:   return c->suffix._0_to_7.u_64 == suffix->_0_to_7.u_64;
+    case 7:   return c->suffix._0_to_7.u_64 == suffix->_0_to_7.u_64   &&   c->suffix._8_to_F.u_32 == suffix->_8_to_F.u_32;
+    default:  return c->suffix._0_to_7.u_64 == suffix->_0_to_7.u_64   &&   c->suffix._8_to_F.u_64 == suffix->_8_to_F.u_64;
+    }
+}
 
-    u64 hash64 = suffix._0_to_7.u_64;
-    u32 hash32 = hash64 + (hash64 >> 32);
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_05;
+static inline u08 tag_of(   u64 hash   ) {
+    u08 tag = hash >> 56;
+    return tag + !tag;                  /* Zero means 'empty'. */
+}
 
-    {   Context** patchpoint = &hashtab_05[ hash32 ];
-        Context*  c;
-        for (c = *patchpoint;   c;   patchpoint = &c->hashlink, c = *patchpoint) {
-            if (c->suffix._0_to_7.u_64 == suffix._0_to_7.u_64){
-                *patchpoint = c->hashlink;
-                return;  
-            }
-        }
+static inline uint tag_matches(   Hash_Bucket* bucket,   u08 tag   ) {
+
+    /* Return a bitmask of the slots in */
+    /* 'bucket' holding 'tag':          */
+
+#ifdef __SSE2__
+    /* One compare does the whole bucket;  the load also */
+    /* picks up 'displaced', which the mask discards:    */
+    __m128i tags = _mm_loadu_si128( (__m128i*) bucket->tag );
+    __m128i hits = _mm_cmpeq_epi8( tags, _mm_set1_epi8( (char) tag ) );
+    return _mm_movemask_epi8( hits ) & ((1 << HASH_BUCKET_SLOTS) -1);
+#else
+    uint hits = 0;
+    int  i;
+    for (i = HASH_BUCKET_SLOTS;   i --> 0;   ) {
+        hits = (hits << 1) | (bucket->tag[i] == tag);
     }
-    assert( 0 && "Attempt to drop Context not in hashtab_5[]" );
+    return hits;
+#endif
 }
 
-Context* hash_Find_Context_05(   Suffix suffix   ) {
+static inline Context* table_find(   Hash_Table* t,   int order,   Suffix* suffix,   u64 hash   ) {
 
-    u64 hash64 = suffix._0_to_7.u_64;
-    u32 hash32 = hash64 + (hash64 >> 32);
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_05;
+    u08  tag  = tag_of( hash );
+    uint b    = hash & t->mask;
 
-    {   Context* c;
-        for (c = hashtab_05[ hash32 ];   c;   c = c->hashlink) {
-            if (c->suffix._0_to_7.u_64 == suffix._0_to_7.u_64){
-                return c;
-            }
+    for (;;) {
+
+        Hash_Bucket* bucket = &t->bucket[ b ];
+        uint         hits   = tag_matches( bucket, tag );
+
+        while (hits) {
+            Context* c = &contexts[ bucket->index[ __builtin_ctz( hits ) ] ];
+            if (same_suffix( c, order, suffix ))   return c;
+            hits &= hits -1;
         }
+
+        /* Nothing homed at or before this */
+        /* bucket spilled past it?  Done:  */
+        if (!bucket->displaced)   return NULL;
+
+        b = (b +1) & t->mask;
     }
-    return NULL;
 }
 
+static inline void table_note(   Hash_Table* t,   u64 hash,   u32 index   ) {
 
+    uint b     = hash & t->mask;
+    uint steps = 0;
 
+    for (;;) {
 
-void     hash_Note_Context_08(   Context* context,   Suffix suffix   ) {
+        Hash_Bucket* bucket = &t->bucket[ b ];
+        uint         empty  = tag_matches( bucket, 0 );
 
-    u64 hash64 = suffix._0_to_7.u_64;
-    u32 hash32 = hash64 + (hash64 >> 32);
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_08;
+        if (empty) {
+            int i = __builtin_ctz( empty );
+            bucket->tag[   i ] = tag_of( hash );
+            bucket->index[ i ] = index;
+            return;
+        }
 
-    context->hashlink = hashtab_08[ hash32 ];
-    hashtab_08[ hash32 ] = context;
+        ++ bucket->displaced;
+
+        b = (b +1) & t->mask;
+        ++steps;
+        assert( steps <= t->mask && "Context hashtable full?!" );
+    }
 }
 
-void     hash_Drop_Context_08(   Context* context   ) {
+static inline bool table_drop(   Hash_Table* t,   u64 hash,   u32 index   ) {
+
+    /* We know exactly which index we are looking */
+    /* for, so there is no need to touch Contexts. */
+    /* Return FALSE if it is not in this table.    */
+
+    u08  tag   = tag_of( hash );
+    uint home  = hash & t->mask;
+    uint b     = home;
 
-    Suffix suffix = context->suffix;
+    for (;;) {
 
-    u64 hash64 = suffix._0_to_7.u_64;
-    u32 hash32 = hash64 + (hash64 >> 32);
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_08;
+        Hash_Bucket* bucket = &t->bucket[ b ];
+        uint         hits   = tag_matches( bucket, tag );
 
-    {   Context** patchpoint = &hashtab_08[ hash32 ];
-        Context*  c;
-        for (c = *patchpoint;   c;   patchpoint = &c->hashlink, c = *patchpoint) {
-            if (c->suffix._0_to_7.u_64 == suffix._0_to_7.u_64){
-                *patchpoint = c->hashlink;
-                return;  
+        while (hits) {
+            int i = __builtin_ctz( hits );
+            if (bucket->index[ i ] == index) {
+                bucket->tag[ i ] = 0;
+
+                /* It passed through the buckets */
+                /* before this one on insertion: */
+                for (;   home != b;   home = (home +1) & t->mask) {
+                    assert( t->bucket[ home ].displaced );
+                    -- t->bucket[ home ].displaced;
+                }
+                return TRUE;
             }
+            hits &= hits -1;
         }
+
+        if (!bucket->displaced)   return FALSE;
+
+        b = (b +1) & t->mask;
     }
-    assert( 0 && "Attempt to drop Context not in hashtab_08[]" );
 }
 
-Context* hash_Find_Context_08(   Suffix suffix   ) {
+static void migrate(   Hash_Index* x,   int order,   uint buckets   ) {
+
+    /* Move the next 'buckets' buckets of x->old into x->now.  */
+    /* We leave the old 'displaced' counts alone:  Too high is */
+    /* merely slower for lookups, and the table is going away. */
+
+    Hash_Table* old = x->old;
 
-    u64 hash64 = suffix._0_to_7.u_64;
-    u32 hash32 = hash64 + (hash64 >> 32);
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_08;
+    for (;   buckets   &&   x->migrated <= old->mask;   --buckets) {
 
-    {   Context* c;
-        for (c = hashtab_08[ hash32 ];   c;   c = c->hashlink) {
-            if (c->suffix._0_to_7.u_64 == suffix._0_to_7.u_64){
-                return c;
+        Hash_Bucket* bucket = &old->bucket[ x->migrated++ ];
+        int          i;
+
+        for (i = 0;   i < HASH_BUCKET_SLOTS;   ++i) {
+            if (bucket->tag[ i ]) {
+                u32 index = bucket->index[ i ];
+                table_note( x->now, suffix_hash( order, &contexts[ index ].suffix ), index );
+                bucket->tag[ i ] = 0;
             }
         }
     }
-    return NULL;
+
+    if (x->migrated > old->mask) {
+        x->old = NULL;
+        retire( old );
+    }
 }
 
+static inline Context* find(   Hash_Index* x,   int order,   Suffix suffix   ) {
 
+    u64      hash = suffix_hash( order, &suffix );
+    Context* c    = table_find( x->now, order, &suffix, hash );
 
+    if (!c   &&   x->old)   c = table_find( x->old, order, &suffix, hash );
+    return c;
+}
 
+static inline void note(   Hash_Index* x,   int order,   Context* context,   Suffix suffix   ) {
 
+    if (x->old) {
+        migrate( x, order, HASH_MIGRATE_STEP );
+    } else if (x->count >= (x->now->mask +1) * (HASH_BUCKET_SLOTS * 3 / 4)   &&   x->now->mask < x->max_mask) {
+        x->old      = x->now;
+        x->migrated = 0;
+        __atomic_store_n( &x->now, table_create( (x->old->mask +1) << 1 ), __ATOMIC_RELEASE );
+        migrate( x, order, HASH_MIGRATE_STEP );
+    }
 
+    table_note( x->now, suffix_hash( order, &suffix ), context - contexts );
+    ++ x->count;
+}
 
-void     hash_Note_Context_12(   Context* context,   Suffix suffix   ) {
+static inline void drop(   Hash_Index* x,   int order,   Context* context   ) {
 
-    u64 hash64 = suffix._0_to_7.u_64 + suffix._8_to_F.u_32;
-    u32 hash32 = hash64 + (hash64 >> 32);
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_12;
+    u64 hash  = suffix_hash( order, &context->suffix );
+    u32 index = context - contexts;
 
-    context->hashlink = hashtab_12[ hash32 ];
-    hashtab_12[ hash32 ] = context;
+    if (!table_drop( x->now, hash, index )) {
+        bool dropped = x->old   &&   table_drop( x->old, hash, index );
+        assert( dropped && "Attempt to drop Context not in hashtab" );
+        (void) dropped;
+    }
+    -- x->count;
 }
 
-void     hash_Drop_Context_12(   Context* context   ) {
 
-    Suffix suffix = context->suffix;
 
-    u64 hash64 = suffix._0_to_7.u_64 + suffix._8_to_F.u_32;
-    u32 hash32 = hash64 + (hash64 >> 32);
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_12;
 
-    {   Context** patchpoint = &hashtab_12[ hash32 ];
-        Context*  c;
-        for (c = *patchpoint;   c;   patchpoint = &c->hashlink, c = *patchpoint) {
-            if (c->suffix._0_to_7.u_64 == suffix._0_to_7.u_64
-            &&  c->suffix._8_to_F.u_32 == suffix._8_to_F.u_32
-            ){
-                *patchpoint = c->hashlink;
-                return;  
-            }
-        }
-    }
-    assert( 0 && "Attempt to drop Context not in hashtab_12[]" );
-}
+Context* hash_Find_Context_03(   Suffix suffix   ) {   return find( &hashtab[3], 3, suffix );           }
+void     hash_Note_Context_03(   Context* context,   Suffix suffix   ) {   note( &hashtab[3], 3, context, suffix );   }
+void     hash_Drop_Context_03(   Context* context   ) {   drop( &hashtab[3], 3, context );                  }
 
-Context* hash_Find_Context_12(   Suffix suffix   ) {
+Context* hash_Find_Context_04(   Suffix suffix   ) {   return find( &hashtab[4], 4, suffix );           }
+void     hash_Note_Context_04(   Context* context,   Suffix suffix   ) {   note( &hashtab[4], 4, context, suffix );   }
+void     hash_Drop_Context_04(   Context* context   ) {   drop( &hashtab[4], 4, context );                  }
 
-    u64 hash64 = suffix._0_to_7.u_64 + suffix._8_to_F.u_32;
-    u32 hash32 = hash64 + (hash64 >> 32);
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_12;
+Context* hash_Find_Context_05(   Suffix suffix   ) {   return find( &hashtab[5], 5, suffix );           }
+void     hash_Note_Context_05(   Context* context,   Suffix suffix   ) {   note( &hashtab[5], 5, context, suffix );   }
+void     hash_Drop_Context_05(   Context* context   ) {   drop( &hashtab[5], 5, context );                  }
 
-    {   Context* c;
-        for (c = hashtab_12[ hash32 ];   c;   c = c->hashlink) {
-            if (c->suffix._0_to_7.u_64 == suffix._0_to_7.u_64
-            &&  c->suffix._8_to_F.u_32 == suffix._8_to_F.u_32
-            ){
-                return c;
-            }
-        }
-    }
-    return NULL;
-}
+Context* hash_Find_Context_08(   Suffix suffix   ) {   return find( &hashtab[6], 6, suffix );           }
+void     hash_Note_Context_08(   Context* context,   Suffix suffix   ) {   note( &hashtab[6], 6, context, suffix );   }
+void     hash_Drop_Context_08(   Context* context   ) {   drop( &hashtab[6], 6, context );                  }
 
+Context* hash_Find_Context_12(   Suffix suffix   ) {   return find( &hashtab[7], 7, suffix );           }
+void     hash_Note_Context_12(   Context* context,   Suffix suffix   ) {   note( &hashtab[7], 7, context, suffix );   }
+void     hash_Drop_Context_12(   Context* context   ) {   drop( &hashtab[7], 7, context );                  }
 
+Context* hash_Find_Context_16(   Suffix suffix   ) {   return find( &hashtab[8], 8, suffix );           }
+void     hash_Note_Context_16(   Context* context,   Suffix suffix   ) {   note( &hashtab[8], 8, context, suffix );   }
+void     hash_Drop_Context_16(   Context* context   ) {   drop( &hashtab[8], 8, context );                  }
 
 
-void     hash_Note_Context_16(   Context* context,   Suffix suffix   ) {
 
-    u64 hash64 = suffix._0_to_7.u_64 + suffix._8_to_F.u_64;
-    u32 hash32 = hash64 + (hash64 >> 32);
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_16;
 
-    context->hashlink = hashtab_16[ hash32 ];
-    hashtab_16[ hash32 ] = context;
-}
 
-void     hash_Drop_Context_16(   Context* context   ) {
+/* A read-only probe for the look-ahead thread in lookahead.c.   */
+/* It runs concurrently with the coding thread's inserts and     */
+/* deletes, so it may see stale or half-written buckets:  We     */
+/* bound the walk, and our caller must revalidate whatever we    */
+/* return via hash_Context_Matches() before trusting it.  This   */
+/* is safe memory-wise because every index ever stored in a      */
+/* bucket is inside 'contexts', and neither it nor any table     */
+/* is released while a file is being compressed.                 */
 
-    Suffix suffix = context->suffix;
+#define HASH_PEEK_MAX_BUCKETS (4)
 
-    u64 hash64 = suffix._0_to_7.u_64 + suffix._8_to_F.u_64;
-    u32 hash32 = hash64 + (hash64 >> 32);
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_16;
+bool hash_Context_Matches(   Context* c,   int order,   Suffix suffix   ) {
 
-    {   Context** patchpoint = &hashtab_16[ hash32 ];
-        Context*  c;
-        for (c = *patchpoint;   c;   patchpoint = &c->hashlink, c = *patchpoint) {
-            if (c->suffix._0_to_7.u_64 == suffix._0_to_7.u_64
-            &&  c->suffix._8_to_F.u_64 == suffix._8_to_F.u_64
-            ){
-                *patchpoint = c->hashlink;
-                return;  
-            }
-        }
+    if (c->order != order)   return FALSE;   /* Recycled, or reused at another order. */
+
+    switch (order) {
+    case 2:   return c->suffix._0_to_7.u_16 == suffix._0_to_7.u_16;
+    case 3:
+    case 4:   return c->suffix._0_to_7.u_32 == suffix._0_to_7.u_32;
+    case 5:
+    case 6:   return c->suffix._0_to_7.u_64 == suffix._0_to_7.u_64;
+    case 7:   return c->suffix._0_to_7.u_64 == suffix._0_to_7.u_64   &&   c->suffix._8_to_F.u_32 == suffix._8_to_F.u_32;
+    case 8:   return c->suffix._0_to_7.u_64 == suffix._0_to_7.u_64   &&   c->suffix._8_to_F.u_64 == suffix._8_to_F.u_64;
+    default:
+        assert( 0 && "bad order?!" );
+        return FALSE;
     }
-    assert( 0 && "Attempt to drop Context not in hashtab_16[]" );
 }
 
-Context* hash_Find_Context_16(   Suffix suffix   ) {
+static Context* table_peek(   Hash_Table* t,   int order,   Suffix suffix,   u64 hash   ) {
+
+    u08  tag = tag_of( hash );
+    uint b   = hash & t->mask;
+    int  steps;
 
-    u64 hash64 = suffix._0_to_7.u_64 + suffix._8_to_F.u_64;
-    u32 hash32 = hash64 + (hash64 >> 32);
-    hash32     = hash32 + (hash32 >> 16);
-    hash32    &= HASH_MASK_16;
+    for (steps = 0;   steps < HASH_PEEK_MAX_BUCKETS;   ++steps) {
 
-    {   Context* c;
-        for (c = hashtab_16[ hash32 ];   c;   c = c->hashlink) {
-            if (c->suffix._0_to_7.u_64 == suffix._0_to_7.u_64
-            &&  c->suffix._8_to_F.u_64 == suffix._8_to_F.u_64
-            ){
-                return c;
+        Hash_Bucket* bucket = &t->bucket[ b ];
+        int          i;
+
+        for (i = 0;   i < HASH_BUCKET_SLOTS;   ++i) {
+            if (__atomic_load_n( &bucket->tag[ i ], __ATOMIC_RELAXED ) == tag) {
+                Context* c = &contexts[ __atomic_load_n( &bucket->index[ i ], __ATOMIC_RELAXED ) ];
+                if (hash_Context_Matches( c, order, suffix ))   return c;
             }
         }
+        if (!__atomic_load_n( &bucket->displaced, __ATOMIC_RELAXED ))   break;
+
+        b = (b +1) & t->mask;
     }
     return NULL;
 }
 
+Context* hash_Peek_Context(   int order,   Suffix suffix   ) {
+
+    Hash_Table* now;
+    Hash_Table* old;
+    Context*    c;
+    u64         hash;
+
+    if (order == 2)   return __atomic_load_n( &hashtab_02[ suffix._0_to_7.u_16 ], __ATOMIC_RELAXED );
+
+    assert( order >= 3   &&   order <= PZIP_ORDER );
+
+    /* A table we read here may be outgrown as we look, */
+    /* but will not be freed until the next file:       */
+    now  = __atomic_load_n( &hashtab[ order ].now, __ATOMIC_ACQUIRE );
+    old  = __atomic_load_n( &hashtab[ order ].old, __ATOMIC_RELAXED );
+    hash = suffix_hash( order, &suffix );
+
+    c = table_peek( now, order, suffix, hash );
+    if (!c   &&   old)   c = table_peek( old, order, suffix, hash );
+    return c;
+}
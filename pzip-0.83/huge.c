@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include "huge.h"
+#include "safe.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+/*************************************************************/
+/* On x86 a 4KB page TLB covers a few MB at most, while our  */
+/* model is hundreds of MB probed essentially at random, so  */
+/* nearly every hash probe and SEE lookup also misses the    */
+/* TLB.  With 2MB pages the same TLB covers gigabytes.       */
+/*                                                           */
+/* For each region of at least HUGE_MIN_BYTES we try, in     */
+/* order:                                                    */
+/*                                                           */
+/*   HUGE_HUGETLB:  mmap( MAP_HUGETLB ), i.e. pages reserved */
+/*                  up front in the hugetlbfs pool.  Fails   */
+/*                  at once unless root set one up, which    */
+/*                  is the usual case.                       */
+/*   HUGE_THP:      An ordinary anonymous mmap aligned to    */
+/*                  HUGE_PAGE_BYTES, plus madvise( MADV_     */
+/*                  HUGEPAGE ) to ask the kernel to back it  */
+/*                  with transparent huge pages.  Whether it */
+/*                  does depends on /sys/kernel/mm/transpa-  */
+/*                  rent_hugepage and on fragmentation.      */
+/*   HUGE_HEAP:     Plain aligned calloc().                  */
+/*                                                           */
+/* Smaller regions go straight to the heap, as they would    */
+/* waste most of a huge page.  mmap()ed memory comes zeroed  */
+/* and is only faulted in when touched, so big tables which  */
+/* stay mostly empty on small inputs cost next to nothing.   */
+/*                                                           */
+/* We keep a list of what we handed out, both so huge_Free() */
+/* knows how to release it and so huge_Report() can tell    */
+/* how much of it the kernel actually backed with huge       */
+/* pages, which for THP we learn from /proc/self/smaps.      */
+/*************************************************************/
+
+#define HUGE_PAGE_BYTES ((size_t)2 << 20)
+#define HUGE_MIN_BYTES  (HUGE_PAGE_BYTES)
+
+typedef enum { HUGE_HEAP, HUGE_THP, HUGE_HUGETLB } Huge_Kind;
+
+typedef struct Huge_Region Huge_Region;
+struct Huge_Region {
+    Huge_Region* next;
+    u08*         base;
+    size_t       size;                  /* Bytes mapped, a multiple of HUGE_PAGE_BYTES unless HUGE_HEAP. */
+    Huge_Kind    kind;
+};
+
+static Huge_Region* regions = NULL;
+
+#ifdef __linux__
+
+static void* map_hugetlb(   size_t size   ) {
+#ifdef MAP_HUGETLB
+    void* p = mmap( NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0 );
+    if (p != MAP_FAILED)   return p;
+#endif
+    return NULL;
+}
+
+static void* map_thp(   size_t size   ) {
+
+    /* Over-allocate by a page so we can trim the */
+    /* ends back to a huge-page aligned region:   */
+    size_t span = size + HUGE_PAGE_BYTES;
+    u08*   p    = mmap( NULL, span, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0 );
+    u08*   base;
+    size_t head;
+
+    if (p == MAP_FAILED)   return NULL;
+
+    base = (u08*) (((size_t)p + HUGE_PAGE_BYTES -1) & ~(HUGE_PAGE_BYTES -1));
+    head = base - p;
+    if (head)                 munmap( p,           head                );
+    if (span - head > size)   munmap( base + size, span - head - size  );
+
+#ifdef MADV_HUGEPAGE
+    madvise( base, size, MADV_HUGEPAGE );
+#endif
+    return base;
+}
+
+#endif /* __linux__ */
+
+void* huge_Calloc(   size_t size   ) {
+
+    Huge_Region* r = new( Huge_Region );
+
+    r->next = regions;
+    regions = r;
+
+#ifdef __linux__
+    if (size >= HUGE_MIN_BYTES) {
+
+        r->size = (size + HUGE_PAGE_BYTES -1) & ~(HUGE_PAGE_BYTES -1);
+
+        if ((r->base = map_hugetlb( r->size ))) {   r->kind = HUGE_HUGETLB;   return r->base;   }
+        if ((r->base = map_thp(     r->size ))) {   r->kind = HUGE_THP;       return r->base;   }
+    }
+#endif
+
+    r->kind = HUGE_HEAP;
+    r->size = size;
+    r->base = safe_Aligned_Calloc( 64, size );
+    return r->base;
+}
+
+void huge_Free(   void* ptr   ) {
+
+    Huge_Region** link;
+
+    if (!ptr)   return;
+
+    for (link = &regions;   *link;   link = &(*link)->next) {
+
+        Huge_Region* r = *link;
+
+        if (r->base == ptr) {
+            *link = r->next;
+#ifdef __linux__
+            if (r->kind != HUGE_HEAP)   munmap( r->base, r->size );
+            else
+#endif
+                                        free( r->base );
+            destroy( r );
+            return;
+        }
+    }
+    assert( !"huge_Free(): Not from huge_Calloc()" );
+}
+
+#ifdef __linux__
+
+static void thp_usage(   size_t* resident,   size_t* huge   ) {
+
+    /* Sum the Rss and AnonHugePages of every */
+    /* mapping overlapping one of our THP     */
+    /* regions:                               */
+
+    FILE*  fp     = fopen( "/proc/self/smaps", "r" );
+    char   line[ 256 ];
+    bool   ours   = FALSE;
+
+    if (!fp)   return;
+
+    while (fgets( line, sizeof( line ), fp )) {
+
+        unsigned long lo, hi, kb;
+
+        if (sscanf( line, "%lx-%lx ", &lo, &hi ) == 2) {
+            Huge_Region* r;
+            ours = FALSE;
+            for (r = regions;   r;   r = r->next) {
+                if (r->kind == HUGE_THP   &&   (u08*)lo < r->base + r->size   &&   r->base < (u08*)hi)   ours = TRUE;
+            }
+        } else if (ours) {
+            if (sscanf( line, "Rss: %lu kB",           &kb ) == 1)   *resident += (size_t)kb << 10;
+            if (sscanf( line, "AnonHugePages: %lu kB", &kb ) == 1)   *huge     += (size_t)kb << 10;
+        }
+    }
+    fclose( fp );
+}
+
+#endif /* __linux__ */
+
+void huge_Report(   void   ) {
+
+    /* Untouched parts of a mapping cost nothing, */
+    /* so measure against what is resident.  We   */
+    /* count heap regions as resident throughout: */
+
+    Huge_Region* r;
+    size_t       bytes   = 0;
+    size_t       hugetlb = 0;
+    size_t       thp     = 0;
+
+    for (r = regions;   r;   r = r->next) {
+        if (r->kind == HUGE_HUGETLB)   hugetlb += r->size;
+        if (r->kind == HUGE_HEAP   )   bytes   += r->size;
+    }
+#ifdef __linux__
+    thp_usage( &bytes, &thp );
+#endif
+    bytes += hugetlb;
+
+    fprintf( stderr,
+        "huge pages: %lu of %lu MB resident in model arenas (%2.1f%%): %lu MB hugetlbfs, %lu MB transparent\n",
+        (unsigned long)((hugetlb + thp) >> 20),   (unsigned long)(bytes >> 20),
+        bytes ? 100.0 * (hugetlb + thp) / bytes : 0.0,
+        (unsigned long)(hugetlb >> 20),   (unsigned long)(thp >> 20)
+    );
+}
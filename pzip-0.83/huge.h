@@ -0,0 +1,16 @@
+#ifndef HUGE_H
+#define HUGE_H
+
+#include "inc.h"
+
+/* Zeroed memory for the big, randomly-probed model arrays  */
+/* (Context arena, hashtables, SEE, deterministic window),  */
+/* backed by huge pages where the system lets us, so that   */
+/* a probe costs a cache miss rather than also a TLB miss.  */
+/* See the comments in huge.c.                              */
+
+void* huge_Calloc(   size_t size   );
+void  huge_Free(     void*  ptr    );
+void  huge_Report(   void          );  /* Coverage to stderr, for -v. */
+
+#endif /* HUGE_H */
@@ -50,8 +50,26 @@ uint ilog2round( uint val ) {
 }
 
 uint ilog2round_tab[ 8192 ];
+u32  recip_tab[ 1 << RECIP_BITS ];
 
-void intmath_init( void ) { int i;  for (i = 8192;  i --> 1; )  ilog2round_tab[i] = ilog2round( i );  }
+void intmath_init( void ) {
+    int i;
+    for (i = 8192;  i --> 1; )  ilog2round_tab[i] = ilog2round( i );
+
+    /* floor( 2^(30 + ceil(log2(d))) / d ) + 1, which fits in */
+    /* 32 bits;  entries 0 and 1 are never used:              */
+    for (i = 1 << RECIP_BITS;   i --> 2;   ) {
+        int l = 32 - __builtin_clz( i - 1 );
+        recip_tab[i] = (u32) ((1ULL << (30 + l)) / i + 1);
+    }
+}
+
+uint intdiv( uint n, uint d ) {
+    if (n < (1u << 30)   &&   d - 2 < (1u << RECIP_BITS) - 2) {
+        return ((u64)n * recip_tab[ d ]) >> (62 - __builtin_clz( d - 1 ));
+    }
+    return n / d;
+}
 
 
 uint ilog2ceil( uint val ) {
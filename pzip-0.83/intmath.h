@@ -7,6 +7,28 @@ extern void intmath_init( void );
 extern uint ilog2round_tab[ 8192 ];
 #define ilog2roundtab(i) ilog2round_tab[ (i) & 8191 ]
 
+/* Division without a divide instruction for small divisors: */
+/* For n < 2^30 and 2 <= d < 2^RECIP_BITS, n / d is exactly   */
+/* (n * recip_tab[d]) >> (30 + ceil(log2(d))).  See Granlund */
+/* & Montgomery, "Division by Invariant Integers using       */
+/* Multiplication", PLDI 1994.  Other n, d just divide.      */
+#define RECIP_BITS (14)
+extern u32 recip_tab[ 1 << RECIP_BITS ];
+
+uint intdiv( uint n, uint d );
+
+/* Bits to shift 'n' right to bring it below 2^bits, else 0: */
+#define intshift_below(n,bits) max( 0, 32 - (bits) - __builtin_clz( (n) | 1 ) )
+
+#ifdef __GNUC__
+extern inline uint intdiv( uint n, uint d ) {
+    if (n < (1u << 30)   &&   d - 2 < (1u << RECIP_BITS) - 2) {
+        return ((u64)n * recip_tab[ d ]) >> (62 - __builtin_clz( d - 1 ));
+    }
+    return n / d;
+}
+#endif
+
 
 #ifndef ispow2
 #define ispow2(x) (!( (x) & ~(-(x)) ))
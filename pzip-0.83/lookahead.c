@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "lookahead.h"
+#include "hash.h"
+#include "safe.h"
+
+/*************************************************************/
+/* When encoding, the whole input is known up front, so the  */
+/* Suffix keys trie_Fill_Active_Contexts() will need for     */
+/* each upcoming symbol can be computed in advance.  We run  */
+/* a helper thread up to LOOKAHEAD_WINDOW symbols ahead of   */
+/* the coding thread which does exactly that, probes the     */
+/* Context hashtables for each order, and prefetches what it */
+/* finds.  The coding thread then collects the results via   */
+/* lookahead_Get_Hints() one symbol at a time.               */
+/*                                                           */
+/* The helper never modifies the trie.  Since the coding     */
+/* thread keeps creating and recycling Contexts underneath   */
+/* it, every hint is only a candidate:  trie_Fill_Active_    */
+/* Contexts() revalidates it against its order and suffix    */
+/* before use, and falls back to a normal search otherwise,  */
+/* so the set of active Contexts -- and hence the bitstream  */
+/* -- is exactly what it would have been without us.         */
+/*                                                           */
+/* The handoff is a single-producer single-consumer ring:    */
+/* The helper has filled hints[] for all positions below     */
+/* 'produced', the coder is finished with all positions      */
+/* below 'consumed', and the helper never gets more than     */
+/* LOOKAHEAD_WINDOW positions ahead of the coder.  If the    */
+/* helper falls behind, the coder simply doesn't wait.       */
+/*                                                           */
+/* The window is kept short on purpose:  A symbol's probes   */
+/* and prefetches touch a couple of dozen cache lines, so    */
+/* 128 symbols' worth is a few hundred KB, which is about    */
+/* what stays cached until the coder gets there.  Running    */
+/* further ahead just evicts our own prefetches.             */
+/*                                                           */
+/* With one CPU the helper can only steal time from the      */
+/* coder, so lookahead_Create() declines to start it there.  */
+/*************************************************************/
+
+#define LOOKAHEAD_WINDOW (128)         /* Must be a power of two. */
+#define LOOKAHEAD_MASK   (LOOKAHEAD_WINDOW -1)
+
+typedef struct {
+    Context* c[ PZIP_ORDER +1 ];
+} Hints;
+
+struct Lookahead {
+    u08*      input_start;
+    uint      input_len;
+
+    pthread_t thread;
+    bool      thread_running;
+
+    uint      produced;                 /* Written by helper only. */
+    uint      consumed;                 /* Written by coder  only. */
+    int       quit;
+
+    uint      hinted;                   /* Positions for which hints were ready. */
+
+    Hints     hints[ LOOKAHEAD_WINDOW ];
+};
+
+static void resolve(   Lookahead* self,   uint i   ) {
+
+    Suffix suffix[ PZIP_ORDER +1 ];
+    Hints* h = &self->hints[ i & LOOKAHEAD_MASK ];
+
+    trie_Get_Suffixes( self->input_start + i, suffix );
+
+    {   int order;
+        for (order = PZIP_ORDER;   order >= 2;   --order) {
+
+            Context* c = hash_Peek_Context( order, suffix[ order ] );
+
+            /* Pre-touch what the coder will splice and scan: */
+            if (c) {
+                __builtin_prefetch( c->least_recently_used.prev );
+                __builtin_prefetch( c->least_recently_used.next );
+                __builtin_prefetch( c->followset                );
+                __builtin_prefetch( c->followset_array          );
+            }
+            h->c[ order ] = c;
+        }
+    }
+}
+
+static void* run(   void* arg   ) {
+
+    Lookahead* self = arg;
+    uint       i    = 0;
+
+    while (i < self->input_len) {
+
+        uint consumed = __atomic_load_n( &self->consumed, __ATOMIC_ACQUIRE );
+
+        if (__atomic_load_n( &self->quit, __ATOMIC_RELAXED ))   break;
+
+        /* Work already overtaken by the coder is useless, so skip it: */
+        if (i < consumed)   i = consumed;
+
+        if (i - consumed >= LOOKAHEAD_WINDOW) {
+            sched_yield();
+            continue;
+        }
+
+        resolve( self, i );
+        ++i;
+        __atomic_store_n( &self->produced, i, __ATOMIC_RELEASE );
+    }
+
+    return NULL;
+}
+
+Lookahead* lookahead_Create(   u08* input_ptr,   u08* input_end   ) {
+
+    Lookahead* self;
+
+    if (sysconf( _SC_NPROCESSORS_ONLN ) <= 1) {
+        if (verbose)   fputs( "lookahead: only one CPU, continuing without helper thread\n", stderr );
+        return NULL;
+    }
+
+    self = safe_Malloc( sizeof( Lookahead ) );
+
+    self->input_start    = input_ptr;
+    self->input_len      = input_end - input_ptr;
+    self->produced       = 0;
+    self->consumed       = 0;
+    self->quit           = FALSE;
+    self->hinted         = 0;
+    self->thread_running = !pthread_create( &self->thread, NULL, run, self );
+
+    if (!self->thread_running && verbose) {
+        fputs( "lookahead: couldn't start helper thread, continuing without it\n", stderr );
+    }
+
+    return self;
+}
+
+void lookahead_Destroy(   Lookahead* self   ) {
+
+    if (!self)   return;
+
+    if (self->thread_running) {
+        __atomic_store_n( &self->quit, TRUE, __ATOMIC_RELAXED );
+        pthread_join( self->thread, NULL );
+    }
+
+    if (verbose) {
+        fprintf( stderr, "lookahead: hints ready for %u of %u symbols\n", self->hinted, self->input_len );
+    }
+
+    free( self );
+}
+
+bool lookahead_Get_Hints(   Lookahead* self,   u08* input_ptr,   Context* hint[ PZIP_ORDER +1 ]   ) {
+
+    uint i     = input_ptr - self->input_start;
+    bool ready = i < __atomic_load_n( &self->produced, __ATOMIC_ACQUIRE );
+
+    assert( i < self->input_len );
+
+    if (ready) {
+        memcpy( hint, self->hints[ i & LOOKAHEAD_MASK ].c, sizeof( Hints ) );
+        ++ self->hinted;
+    }
+
+    /* Let the helper reuse this slot: */
+    __atomic_store_n( &self->consumed, i +1, __ATOMIC_RELEASE );
+
+    return ready;
+}
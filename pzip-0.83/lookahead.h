@@ -0,0 +1,27 @@
+#ifndef LOOKAHEAD_H
+#define LOOKAHEAD_H
+
+#include "inc.h"
+#include "config.h"
+#include "context.h"
+
+/* An optional encoder-side helper thread which runs up to a */
+/* hundred or so symbols ahead of pzip_Encode(), resolving   */
+/* active Contexts and pre-touching their cache lines.  See  */
+/* the comments in lookahead.c.  lookahead_Create() returns  */
+/* NULL on a single-CPU machine, where it could only hurt.   */
+/*                                                           */
+/* EXPERIMENTAL:  Whether this is a win on a multi-core      */
+/* machine has not been measured, so -t is marked as such.   */
+/* The helper also reads Context fields while the coder      */
+/* writes them, without atomics.  That is a data race in     */
+/* C11 terms, tolerated only because every hint is checked   */
+/* again by hash_Context_Matches() before it is used.        */
+
+typedef struct Lookahead Lookahead;
+
+Lookahead* lookahead_Create(    u08* input_ptr,   u08* input_end   );
+void       lookahead_Destroy(   Lookahead* self   );
+bool       lookahead_Get_Hints( Lookahead* self,   u08* input_ptr,   Context* hint[ PZIP_ORDER +1 ]   );
+
+#endif /* LOOKAHEAD_H */
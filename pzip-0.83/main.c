@@ -17,7 +17,8 @@
 
 #define PREAMBLE	(1024)
 
-static const u32 PZIP_MAGIC = 0x70707A32; /* "PPZ2" */
+static const u32 PZIP_MAGIC         = 0x70707A32; /* "PPZ2" */
+static const u32 PZIP_MAGIC_OPTIONS = 0x70707A33; /* "PPZ3":  Header also has pzip_options. */
  
 static int byte_which_differs( u08* buf1, u08* buf2 ) {
     int b = 0;
@@ -86,6 +87,7 @@ int main(  int argc,   char* argv[] ) {
     FILE*  in_fp    = NULL;
     FILE*  out_fp   = NULL;
     u32  input_crc  = 0;
+    int    header_len = 12;
 
     if (argc < 2) {
 	fprintf(stderr, "pzip version %.2f\n", VERSION );
@@ -93,6 +95,16 @@ int main(  int argc,   char* argv[] ) {
 	fprintf(stderr, "options :\n" );
 	fprintf(stderr, " -e  : encode only [vs also decode and compare]\n");
 	fprintf(stderr, " -v  : verbose output during run\n");
+	fprintf(stderr, " -t  : EXPERIMENTAL: encode using a look-ahead helper thread\n");
+	fprintf(stderr, "       (needs 2+ CPUs; no speedup has been measured yet)\n");
+	fprintf(stderr, " -d  : defer creating contexts until seen twice\n");
+	fprintf(stderr, " -m  : find deterministic matches by hash chains\n");
+	fprintf(stderr, " -r  : also predict from long-range repeats\n");
+	fprintf(stderr, " -f  : code long matches fast, bypassing the model\n");
+	fprintf(stderr, " -c  : use the 64-bit range coder\n");
+	fprintf(stderr, " -wN : deterministic matches reach back 2^N bytes [%d..%d, default %d]\n",
+	    DETERMINISTIC_WINDOW_BITS_MIN, DETERMINISTIC_WINDOW_BITS_MAX, DETERMINISTIC_WINDOW_BITS );
+	fprintf(stderr, "       (only with -m;  otherwise matches die with their contexts)\n");
 	exit(1);
     }
 
@@ -118,6 +130,41 @@ int main(  int argc,   char* argv[] ) {
                 ++verbose;
                 break;
 
+            case 't':
+                pzip_lookahead_thread = TRUE;
+                break;
+
+            case 'd':
+                pzip_options |= PZIP_OPTION_DEFER_CONTEXTS;
+                break;
+
+            case 'm':
+                pzip_options |= PZIP_OPTION_DET_CHAINS;
+                break;
+
+            case 'r':
+                pzip_options |= PZIP_OPTION_LONG_REPEATS;
+                break;
+
+            case 'f':
+                pzip_options |= PZIP_OPTION_MATCH_RUNS;
+                break;
+
+            case 'c':
+                pzip_options |= PZIP_OPTION_RANGE_CODER;
+                break;
+
+            case 'w':
+                {   uint bits = atoi( str );
+                    if (bits < DETERMINISTIC_WINDOW_BITS_MIN || bits > DETERMINISTIC_WINDOW_BITS_MAX) {
+                        die( "main.c:main(): -w window bits out of range.\n" );
+                    }
+                    /* The default needs no header option: */
+                    pzip_options &= ~PZIP_OPTION_DET_WINDOW;
+                    if (bits != DETERMINISTIC_WINDOW_BITS)   pzip_options |= bits << PZIP_OPTION_DET_WINDOW_SHIFT;
+                }
+                break;
+
             default:
                 fprintf(stderr, "unknown option '-%c' skipped\n", str[-1] );
                 break;
@@ -133,6 +180,13 @@ int main(  int argc,   char* argv[] ) {
         }
     }
 
+    /* Without hash chains, a match can only be found while */
+    /* the Trie still holds its context, which seldom lasts */
+    /* anywhere near a wide window:                         */
+    if ((pzip_options & PZIP_OPTION_DET_WINDOW) && !(pzip_options & PZIP_OPTION_DET_CHAINS)) {
+        fputs( "main.c:main(): Warning: -w without -m hardly reaches further.\n", stderr );
+    }
+
     intmath_init();
 
     in_fp = fopen( in_name, "r" );
@@ -151,15 +205,27 @@ int main(  int argc,   char* argv[] ) {
 
         /* Is in_fp compressed? */
         u32 tag = fget_ul( in_fp );
-        if (tag == PZIP_MAGIC) {
+        if (tag == PZIP_MAGIC || tag == PZIP_MAGIC_OPTIONS) {
             /* It is packed: */
             input_len = fget_ul( in_fp );
             input_crc = fget_ul( in_fp );
+            pzip_options = 0;
+            if (tag == PZIP_MAGIC_OPTIONS) {
+                pzip_options = fget_ul( in_fp );
+                header_len  += 4;
+                if (pzip_options & ~PZIP_OPTIONS_KNOWN)   die( "main.c:main(): Input was packed with unsupported options.\n" );
+                {   uint bits = (pzip_options & PZIP_OPTION_DET_WINDOW) >> PZIP_OPTION_DET_WINDOW_SHIFT;
+                    if (bits && (bits < DETERMINISTIC_WINDOW_BITS_MIN || bits > DETERMINISTIC_WINDOW_BITS_MAX)) {
+                        die( "main.c:main(): Input was packed with an unsupported window.\n" );
+                    }
+                }
+            }
             encoding = FALSE;
         } else {
-            /* Not packed: */
+            /* Not packed.  Stick to the old header */
+            /* unless we need to record options:    */
             fseek( in_fp, 0, SEEK_SET );
-            fput_ul( PZIP_MAGIC, out_fp );
+            fput_ul( pzip_options ? PZIP_MAGIC_OPTIONS : PZIP_MAGIC, out_fp );
             fput_ul( input_len, out_fp );
         }
     }
@@ -175,7 +241,10 @@ int main(  int argc,   char* argv[] ) {
 
         input_crc = crc32_Compute_Checksum( input_buf, input_len );
 
-        if (out_fp) { fput_ul(input_crc,out_fp); }
+        if (out_fp) {
+            fput_ul( input_crc, out_fp );
+            if (pzip_options)   fput_ul( pzip_options, out_fp );
+        }
     }
 
     decode_buf = safe_Malloc( input_len + 1024 + PREAMBLE );
@@ -195,9 +264,9 @@ int main(  int argc,   char* argv[] ) {
             );
         }
     } else {
-        /* 12 bytes of header: */
-        encode_len = file_length(in_fp) - 12;
-        fseek( in_fp, 12, SEEK_SET );
+        /* 12 or 16 bytes of header: */
+        encode_len = file_length(in_fp) - header_len;
+        fseek( in_fp, header_len, SEEK_SET );
         fread( encode_buf, 1, encode_len, in_fp );
         fclose(in_fp);
         in_fp = NULL; 
@@ -233,5 +302,7 @@ int main(  int argc,   char* argv[] ) {
         out_fp = NULL;
     }
 
+    pzip_Release();
+
     exit( 0 );
 }
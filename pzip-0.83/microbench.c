@@ -0,0 +1,615 @@
+/* microbench.c:  'make microbench' -- time pzip's hot-path   */
+/* primitives one at a time, so that when whole-file speed    */
+/* changes we can see which of them moved.                    */
+/*                                                            */
+/* We first compress an input (pzip.c unless told otherwise)  */
+/* to get a realistically trained model, then replay that     */
+/* input against it, recording what each primitive would be   */
+/* asked at each position -- suffixes, Contexts, exclusions,  */
+/* SEE states, match candidates -- and time each primitive    */
+/* on its own trace.  The arithmetic coder gets a generated   */
+/* distribution instead.                                      */
+/*                                                            */
+/* Several of the primitives are static, so we compile the    */
+/* modules holding them into this file rather than link them: */
+
+#include <stdio.h>
+#include <time.h>
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#endif
+
+#include "pzip.c"
+#include "see.c"
+#include "deterministic.c"
+
+#include "version.h"
+#include "crc32.h"
+#include "hash.h"
+#include "intmath.h"
+#include "pool.h"
+
+#define PREAMBLE	(1024)	/* As in main.c. */
+#define TRACE_MAX	(1 << 16)
+
+int verbose = FALSE;
+
+static void io_die( const char* plaint, const char* filename ) {
+    char buf[ 1023 ];
+    sprintf( buf, plaint, filename );
+    perror( buf );
+    exit( 1 );
+}
+
+/*****************************************************************/
+/* Traces.                                                       */
+/*****************************************************************/
+
+static u08* input_buf;
+static uint input_len;
+
+/* One sampled input position, as trie_Fill_Active_Contexts() */
+/* would see it:                                              */
+typedef struct {
+    u08*     input_ptr;
+    u32      key;
+    Suffix   suffix[  PZIP_ORDER +1 ];
+    Context* context[ PZIP_ORDER +1 ];     /* NULL if none (any more). */
+} Step;
+
+static Step* steps;
+static uint  num_steps;
+
+/* A Context and the exclusions it would be rated under */
+/* after every higher order escaped:                     */
+typedef struct {
+    Context*         context;
+    Excluded_Symbols excl;
+} Rating;
+
+static Rating* ratings;
+static uint    num_ratings;
+
+/* A See_State lookup and its answer: */
+typedef struct {
+    Context*   context;
+    u32        key;
+    uint       escape_count;
+    uint       total_count;
+    See_State* ss;
+    bool       escape;
+} See_Step;
+
+static See_Step* see_steps;
+static uint      num_see_steps;
+
+/* Deterministic match candidates: */
+typedef struct {
+    u08* p;
+    u08* q;
+} Match;
+
+static Match* matches;
+static uint   num_matches;
+
+static Step** det_steps;                  /* Steps whose order 8 Context has a Det context. */
+static uint   num_det_steps;
+
+static u64 rng_state = 0x9E3779B97F4A7C15ULL;
+
+static u32 rng( void ) {
+    /* xorshift64*, as in bench.c: */
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (u32)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static void exclude_followset(   Excluded_Symbols* excl,   Context* c   ) {
+    if (c->followset_array) {
+        excluded_symbols_Add_All( excl, c->followset_array->present );
+    } else {
+        Followset_Node* n;
+        for (n = c->followset;   n;   n = n->next)   excluded_symbols_Add( excl, n->symbol );
+    }
+}
+
+static void record_traces( void ) {
+
+    See* see   = model->see;
+    Det* det   = model->det;
+    uint first = PZIP_SEED_BYTES + 16;
+    uint stride;
+    uint i;
+
+    if (input_len <= first) {
+        fprintf( stderr, "microbench.c:record_traces(): Input too short.\n" );
+        exit( 1 );
+    }
+    stride = max( 1, (input_len - first) / TRACE_MAX );
+
+    steps     = safe_Malloc( TRACE_MAX * sizeof( Step     ) );
+    ratings   = safe_Malloc( TRACE_MAX * sizeof( Rating   ) );
+    see_steps = safe_Malloc( TRACE_MAX * sizeof( See_Step ) );
+    matches   = safe_Malloc( TRACE_MAX * sizeof( Match    ) );
+    det_steps = safe_Malloc( TRACE_MAX * sizeof( Step*    ) );
+
+    for (i = first;   i < input_len && num_steps < TRACE_MAX;   i += stride) {
+
+        Step* s = &steps[ num_steps++ ];
+        int   o;
+
+        s->input_ptr = input_buf + i;
+        s->key       = getu32( s->input_ptr -4 );
+        trie_Get_Suffixes( s->input_ptr, s->suffix );
+
+        s->context[0] = trie->order0;
+        s->context[1] = trie->order1[ s->input_ptr[ -1 ] ];
+        s->context[2] = hash_Find_Context_02( s->suffix[2] );
+        s->context[3] = hash_Find_Context_03( s->suffix[3] );
+        s->context[4] = hash_Find_Context_04( s->suffix[4] );
+        s->context[5] = hash_Find_Context_05( s->suffix[5] );
+        s->context[6] = hash_Find_Context_08( s->suffix[6] );
+        s->context[7] = hash_Find_Context_12( s->suffix[7] );
+        s->context[8] = hash_Find_Context_16( s->suffix[8] );
+
+        /* The escape cascade, top down: */
+        {   Excluded_Symbols excl;
+            excluded_symbols_Clear( &excl );
+            for (o = PZIP_ORDER;   o >= 0;   --o) {
+                Context* c = s->context[o];
+                if (!c || !c->total_symbol_count)   continue;
+                if (num_ratings < TRACE_MAX) {
+                    ratings[ num_ratings   ].context = c;
+                    ratings[ num_ratings++ ].excl    = excl;
+                }
+                if (num_see_steps < TRACE_MAX) {
+                    See_Step* ss = &see_steps[ num_see_steps ];
+                    ss->context      = c;
+                    ss->key          = s->key;
+                    ss->escape_count = c->escape_count;
+                    ss->total_count  = c->total_symbol_count;
+                    see_Forget( see );
+                    ss->ss           = see_Get_State( see, ss->escape_count, ss->total_count, ss->key, c );
+                    ss->escape       = (rng() & 3) == 0;
+                    if (ss->ss)   ++num_see_steps;
+                }
+                exclude_followset( &excl, c );
+            }
+        }
+
+        /* The deterministic model, as find_best_node() would probe it: */
+        if (s->context[ PZIP_ORDER ] && s->context[ PZIP_ORDER ]->det) {
+            Deterministic_Context* dc = s->context[ PZIP_ORDER ]->det;
+            Deterministic_Node*    node;
+            uint                   visits = 0;
+            det_steps[ num_det_steps++ ] = s;
+            for (node = first_candidate( det, dc, s->input_ptr );   node && num_matches < TRACE_MAX;   node = next_candidate( det, node )) {
+                u08* match = input_buf + node->input_pos;
+                if (match != s->input_ptr   &&   !memcmp( s->input_ptr - 12, match - 12, 12 )) {
+                    matches[ num_matches   ].p = s->input_ptr;
+                    matches[ num_matches++ ].q = match;
+                }
+                if (++visits == DETERMINISTIC_MAX_NODES_TO_VISIT)   break;
+            }
+        }
+    }
+}
+
+/*****************************************************************/
+/* The benchmarks.  Each runs its whole trace once and returns   */
+/* something derived from the results, so that the compiler      */
+/* cannot optimize the work away.                                */
+/*****************************************************************/
+
+#define FIND( nn, o )                                                                           \
+    static u64 find_##nn( void ) {                                                              \
+        u64  sink = 0;                                                                          \
+        uint i;                                                                                 \
+        for (i = 0;   i < num_steps;   ++i)   sink += (size_t)hash_Find_Context_##nn( steps[i].suffix[o] ); \
+        return sink;                                                                            \
+    }
+FIND( 02, 2 )
+FIND( 03, 3 )
+FIND( 04, 4 )
+FIND( 05, 5 )
+FIND( 08, 6 )
+FIND( 12, 7 )
+FIND( 16, 8 )
+#undef FIND
+
+static u64 drop_and_note( void ) {
+
+    /* Take each Context out of its table and put it */
+    /* back, which leaves the tables as they were:   */
+
+    u64  ops = 0;
+    uint i;
+    int  o;
+    for (i = 0;   i < num_steps;   ++i) {
+        for (o = 2;   o <= PZIP_ORDER;   ++o) {
+            Context* c = steps[i].context[o];
+            if (!c || c->order != o)   continue;
+            switch (o) {
+            case 2:   hash_Drop_Context_02( c );   hash_Note_Context_02( c, c->suffix );   break;
+            case 3:   hash_Drop_Context_03( c );   hash_Note_Context_03( c, c->suffix );   break;
+            case 4:   hash_Drop_Context_04( c );   hash_Note_Context_04( c, c->suffix );   break;
+            case 5:   hash_Drop_Context_05( c );   hash_Note_Context_05( c, c->suffix );   break;
+            case 6:   hash_Drop_Context_08( c );   hash_Note_Context_08( c, c->suffix );   break;
+            case 7:   hash_Drop_Context_12( c );   hash_Note_Context_12( c, c->suffix );   break;
+            case 8:   hash_Drop_Context_16( c );   hash_Note_Context_16( c, c->suffix );   break;
+            }
+            ++ops;
+        }
+    }
+    return ops;
+}
+
+static uint count_drop_and_note( void ) {
+    uint n = 0;
+    uint i;
+    int  o;
+    for (i = 0;   i < num_steps;   ++i) {
+        for (o = 2;   o <= PZIP_ORDER;   ++o)   n += steps[i].context[o] && steps[i].context[o]->order == o;
+    }
+    return n;
+}
+
+/* Pool traffic:  A working set of live hunks the size */
+/* of Followset_Nodes, each op replacing a random one: */
+#define POOL_LIVE (1 << 14)
+static Pool* pool_pool       = NULL;
+static int   pool_pool_count = 0;
+static void* pool_live[ POOL_LIVE ];
+static u16   pool_victim[ TRACE_MAX ];
+
+static u64 pool_churn( void ) {
+    u64  sink = 0;
+    uint i;
+    for (i = 0;   i < TRACE_MAX;   ++i) {
+        uint  v = pool_victim[i] & (POOL_LIVE -1);
+        pool_Auto_Free_Hunk( &pool_pool, &pool_pool_count, pool_live[v] );
+        pool_live[v] = pool_Auto_Get_Hunk( &pool_pool, &pool_pool_count, sizeof( Followset_Node ) );
+        sink += (size_t)pool_live[v];
+    }
+    return sink;
+}
+
+/* Arithmetic coding:  A skewed mix of symbol */
+/* intervals and of binary probabilities:     */
+typedef struct {
+    u32 low;
+    u32 high;
+    u32 total;
+    u32 p0;
+    u32 pt;
+    u08 bit;
+} Event;
+
+static Event* events;
+static u08*   arith_buf;
+static Arith* arith;
+
+static void make_events( void ) {
+    uint i;
+    events    = safe_Malloc( TRACE_MAX * sizeof( Event ) );
+    arith_buf = safe_Malloc( TRACE_MAX * 8 + PREAMBLE ) + PREAMBLE;
+    for (i = 0;   i < TRACE_MAX;   ++i) {
+        Event* e     = &events[i];
+        u32    total = 2 + rng() % 4000;
+        u32    width = 1 + (rng() % total) * (rng() % total) / total;   /* Mostly narrow. */
+        e->total = total;
+        e->low   = rng() % (total - width +1);
+        e->high  = e->low + width;
+        e->pt    = 1 << 12;
+        e->p0    = 1 + rng() % (e->pt -1);
+        e->bit   = (rng() % e->pt) >= e->p0;
+    }
+}
+
+static u64 encode_1_of_n( void ) {
+    uint i;
+    arith_Start_Encoding( arith, arith_buf );
+    for (i = 0;   i < TRACE_MAX;   ++i)   arith_Encode_1_Of_N( arith, events[i].low, events[i].high, events[i].total );
+    return arith_Finish_Encoding( arith ) - arith_buf;
+}
+
+static u64 decode_1_of_n( void ) {
+    u64  sink = 0;
+    uint i;
+    arith_Start_Decoding( arith, arith_buf );
+    for (i = 0;   i < TRACE_MAX;   ++i) {
+        sink += arith_Get_1_Of_N( arith, events[i].total );
+        arith_Decode_1_Of_N( arith, events[i].low, events[i].high, events[i].total );
+    }
+    return sink;
+}
+
+static u64 encode_bit( void ) {
+    uint i;
+    arith_Start_Encoding( arith, arith_buf );
+    for (i = 0;   i < TRACE_MAX;   ++i)   arith_Encode_Bit( arith, events[i].p0, events[i].pt, events[i].bit );
+    return arith_Finish_Encoding( arith ) - arith_buf;
+}
+
+static u64 decode_bit( void ) {
+    u64  sink = 0;
+    uint i;
+    arith_Start_Decoding( arith, arith_buf );
+    for (i = 0;   i < TRACE_MAX;   ++i)   sink += arith_Decode_Bit( arith, events[i].p0, events[i].pt ) != events[i].bit;
+    return sink;
+}
+
+/* SEE: */
+static u64 see_get_state( void ) {
+    u64  sink = 0;
+    uint i;
+    for (i = 0;   i < num_see_steps;   ++i) {
+        See_Step* s = &see_steps[i];
+        see_Forget( model->see );   /* Else we'd just be timing the memo. */
+        sink += (size_t)see_Get_State( model->see, s->escape_count, s->total_count, s->key, s->context );
+    }
+    return sink;
+}
+
+static u64 see_get_stats( void ) {
+    u64  sink = 0;
+    uint i;
+    for (i = 0;   i < num_see_steps;   ++i) {
+        See_Step* s = &see_steps[i];
+        X         x = get_stats( model->see, s->ss, s->escape_count, s->escape_count + s->total_count );
+        sink += x.escapes + x.total;
+    }
+    return sink;
+}
+
+static u64 see_adjust_state( void ) {
+    uint i;
+    for (i = 0;   i < num_see_steps;   ++i)   see_Adjust_State( model->see, see_steps[i].ss, see_steps[i].escape );
+    return model->see->order0[0].total;
+}
+
+static u64 followset_stats( void ) {
+    u64  sink = 0;
+    uint i;
+    for (i = 0;   i < num_ratings;   ++i) {
+        Followset_Stats stats = context_Get_Followset_Stats_With_Given_Symbols_Excluded( ratings[i].context, &ratings[i].excl );
+        sink += stats.total_count + stats.max_count + stats.escape_count;
+    }
+    return sink;
+}
+
+/* The deterministic model: */
+static u64 common_suffix( void ) {
+    u64  sink = 0;
+    uint i;
+    for (i = 0;   i < num_matches;   ++i)   sink += longest_common_suffix( matches[i].p, matches[i].q, input_buf );
+    return sink;
+}
+
+static u64 best_node( void ) {
+    u64  sink = 0;
+    uint i;
+    for (i = 0;   i < num_det_steps;   ++i) {
+        find_best_node( model->det, det_steps[i]->context[ PZIP_ORDER ]->det, det_steps[i]->input_ptr, input_buf );
+        sink += model->det->cached_match_len;
+    }
+    return sink;
+}
+
+/* Exclusions: */
+static u08 symbols[ TRACE_MAX ];
+
+static u64 excl_clear( void ) {
+    Excluded_Symbols* e = model->excluded_symbols;
+    uint i;
+    for (i = 0;   i < TRACE_MAX;   ++i) {
+        excluded_symbols_Clear( e );
+        e->bits[ i & 3 ] = i;   /* Keep the stores from being merged away. */
+    }
+    return e->bits[0];
+}
+
+static u64 excl_add( void ) {
+    Excluded_Symbols* e = model->excluded_symbols;
+    uint i;
+    excluded_symbols_Clear( e );
+    for (i = 0;   i < TRACE_MAX;   ++i) {
+        if (!(i & 31))   excluded_symbols_Clear( e );
+        excluded_symbols_Add( e, symbols[i] );
+    }
+    return e->bits[0] ^ e->bits[3];
+}
+
+static u64 excl_contains( void ) {
+    Excluded_Symbols* e = model->excluded_symbols;
+    u64  sink = 0;
+    uint i;
+    excluded_symbols_Clear( e );
+    for (i = 0;   i < 256;   i += 3)   excluded_symbols_Add( e, i );
+    for (i = 0;   i < TRACE_MAX;   ++i)   sink += excluded_symbols_Contains( e, symbols[i] );
+    return sink;
+}
+
+static u64 excl_order_minus_one( void ) {
+    /* The escape to order -1, with about half excluded: */
+    Excluded_Symbols* e = model->excluded_symbols;
+    uint i;
+    excluded_symbols_Clear( e );
+    for (i = 0;   i < 256;   i += 2)   excluded_symbols_Add( e, i );
+    arith_Start_Encoding( arith, arith_buf );
+    for (i = 0;   i < TRACE_MAX;   ++i)   order_minus_one_Encode( symbols[i] | 1, 256, arith, e );
+    return arith_Finish_Encoding( arith ) - arith_buf;
+}
+
+/* 4K blocks, cycling through the input: */
+#define CRC_BLOCK  (4096)
+#define CRC_BLOCKS (256)
+#define crc_block( i )   (input_buf + ((i) * CRC_BLOCK) % (input_len - CRC_BLOCK +1))
+
+static u64 crc_sliced( void ) {
+    u64  sink = 0;
+    uint i;
+    for (i = 0;   i < CRC_BLOCKS;   ++i)   sink += crc32_Compute_Checksum( crc_block( i ), CRC_BLOCK );
+    return sink;
+}
+
+static u64 crc_bytewise( void ) {
+    u64  sink = 0;
+    uint i;
+    for (i = 0;   i < CRC_BLOCKS;   ++i)   sink += crc32_Compute_Checksum_Bytewise( crc_block( i ), CRC_BLOCK );
+    return sink;
+}
+
+/*****************************************************************/
+/* Timing.                                                       */
+/*****************************************************************/
+
+static volatile u64 sink;
+static int          reps = 5;
+
+static double now( void ) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static u64 cycles( void ) {
+#if defined( __x86_64__ ) || defined( __i386__ )
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void run(   const char* name,   u64 (*fn)( void ),   uint ops   ) {
+
+    /* Best of 'reps' runs, after one to warm up: */
+
+    double best_ns     = 1e30;
+    double best_cycles = 1e30;
+    int    r;
+
+    if (!ops) {
+        printf( "%-58s %9s   (no trace)\n", name, "0" );
+        return;
+    }
+
+    sink += fn();
+    for (r = 0;   r < reps;   ++r) {
+        double t0 = now();
+        u64    c0 = cycles();
+        sink += fn();
+        {   u64    c1 = cycles();
+            double t1 = now();
+            best_ns     = min( best_ns,     (t1 - t0) * 1e9 / ops );
+            best_cycles = min( best_cycles, (double)(c1 - c0) / ops );
+        }
+    }
+
+    if (cycles())   printf( "%-58s %9u %9.2f %9.1f\n", name, ops, best_ns, best_cycles );
+    else            printf( "%-58s %9u %9.2f %9s\n",   name, ops, best_ns, "-"         );
+}
+
+int main(  int argc,   char* argv[] ) {
+
+    const char* in_name = "pzip.c";
+    u08*        encode_buf;
+    uint        i;
+
+    ++argv;
+    --argc;
+
+    while (argc > 0) {
+        char* str = *argv++;
+        argc--;
+
+        if (*str != '-') {   in_name = str;   continue;   }
+
+        switch (str[1]) {
+        case 'n':   reps = max( 1, atoi( str +2 ) );                       break;
+        case 'd':   pzip_options |= PZIP_OPTION_DEFER_CONTEXTS;            break;
+        case 'm':   pzip_options |= PZIP_OPTION_DET_CHAINS;                break;
+        case 'r':   pzip_options |= PZIP_OPTION_LONG_REPEATS;              break;
+        case 'f':   pzip_options |= PZIP_OPTION_MATCH_RUNS;                break;
+        default:
+            fprintf(stderr, "Usage : pzip-microbench [options] [file, default pzip.c]\n" );
+            fprintf(stderr, "options :\n" );
+            fprintf(stderr, " -nN : best of N runs per primitive [default 5]\n");
+            fprintf(stderr, " -d -m -r -f : model options as for pzip\n");
+            exit(1);
+        }
+    }
+
+    intmath_init();
+
+    /* Train the model: */
+    {   FILE* fp = fopen( in_name, "r" );
+        if (!fp)   io_die( "microbench.c:main(): Couldn't open input file '%s'", in_name );
+        fseek( fp, 0, SEEK_END );
+        input_len = ftell( fp );
+        fseek( fp, 0, SEEK_SET );
+        input_buf = safe_Malloc( input_len + 1024 + PREAMBLE );
+        memset( input_buf, ' ', PREAMBLE );
+        input_buf += PREAMBLE;
+        if (fread( input_buf, 1, input_len, fp ) != input_len)   io_die( "microbench.c:main(): Couldn't read input file '%s'", in_name );
+        fclose( fp );
+    }
+    encode_buf = safe_Malloc( input_len*2 + 65536 + PREAMBLE );
+    memset( encode_buf, 0, PREAMBLE );
+    pzip_Encode( input_buf, input_len, encode_buf + PREAMBLE );
+
+    record_traces();
+    make_events();
+    for (i = 0;   i < TRACE_MAX;   ++i) {
+        symbols[i]     = input_buf[ i % input_len ];
+        pool_victim[i] = rng();
+    }
+    for (i = 0;   i < POOL_LIVE;   ++i)   pool_live[i] = pool_Auto_Get_Hunk( &pool_pool, &pool_pool_count, sizeof( Followset_Node ) );
+    arith = arith_Create();
+
+    printf( "# pzip %.2f microbenchmarks, model trained on %s (%u bytes), options %u\n", VERSION, in_name, input_len, pzip_options );
+    printf( "%-58s %9s %9s %9s\n", "# primitive", "ops", "ns/op", cycles() ? "cycles/op" : "" );
+
+    run( "hash_Find_Context_02",                                      find_02,               num_steps );
+    run( "hash_Find_Context_03",                                      find_03,               num_steps );
+    run( "hash_Find_Context_04",                                      find_04,               num_steps );
+    run( "hash_Find_Context_05",                                      find_05,               num_steps );
+    run( "hash_Find_Context_08",                                      find_08,               num_steps );
+    run( "hash_Find_Context_12",                                      find_12,               num_steps );
+    run( "hash_Find_Context_16",                                      find_16,               num_steps );
+    run( "hash_Drop_Context_* + hash_Note_Context_*",                 drop_and_note,         count_drop_and_note() );
+    run( "pool_Auto_Free_Hunk + pool_Auto_Get_Hunk",                  pool_churn,            TRACE_MAX );
+
+    arith_Use_Range_Coder( arith, FALSE );
+    run( "arith_Encode_1_Of_N",                                       encode_1_of_n,         TRACE_MAX );
+    run( "arith_Get_1_Of_N + arith_Decode_1_Of_N",                    decode_1_of_n,         TRACE_MAX );
+    run( "arith_Encode_Bit",                                          encode_bit,            TRACE_MAX );
+    run( "arith_Decode_Bit",                                          decode_bit,            TRACE_MAX );
+    arith_Use_Range_Coder( arith, TRUE );
+    run( "arith_Encode_1_Of_N (range coder)",                         encode_1_of_n,         TRACE_MAX );
+    run( "arith_Get_1_Of_N + arith_Decode_1_Of_N (range coder)",      decode_1_of_n,         TRACE_MAX );
+    run( "arith_Encode_Bit (range coder)",                            encode_bit,            TRACE_MAX );
+    run( "arith_Decode_Bit (range coder)",                            decode_bit,            TRACE_MAX );
+    arith_Use_Range_Coder( arith, FALSE );
+
+    run( "see_Get_State (after see_Forget)",                          see_get_state,         num_see_steps );
+    run( "get_stats",                                                 see_get_stats,         num_see_steps );
+    run( "context_Get_Followset_Stats_With_Given_Symbols_Excluded",   followset_stats,       num_ratings );
+    run( "longest_common_suffix",                                     common_suffix,         num_matches );
+    run( "find_best_node",                                            best_node,             num_det_steps );
+    run( "excluded_symbols_Clear",                                    excl_clear,            TRACE_MAX );
+    run( "excluded_symbols_Add",                                      excl_add,              TRACE_MAX );
+    run( "excluded_symbols_Contains",                                 excl_contains,         TRACE_MAX );
+    run( "order_minus_one_Encode (half excluded)",                    excl_order_minus_one,  TRACE_MAX );
+    run( "crc32_Compute_Checksum (4K)",                               crc_sliced,            input_len >= CRC_BLOCK ? CRC_BLOCKS : 0 );
+    run( "crc32_Compute_Checksum_Bytewise (4K)",                      crc_bytewise,          input_len >= CRC_BLOCK ? CRC_BLOCKS : 0 );
+
+    /* Last, since it changes the model: */
+    run( "see_Adjust_State",                                          see_adjust_state,      num_see_steps );
+
+    arith_Destroy( arith );
+    pzip_Release();
+
+    exit( 0 );
+}
@@ -1,49 +1,85 @@
 #include "order-1.h"
 
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
 /*******
 
  Order (-1) coder
 
  Totally flat probabilities with exclusions
 
+ A symbol's rank among the unexcluded ones is a few popcounts
+ over the exclusion bitmap (see excluded_symbols.c), and finding
+ the symbol of a given rank while decoding is a popcount per
+ word plus a select within the word.
+
 *********/
 
+static inline u64 symbols_below(   uint n,   uint word   ) {
+
+    /* Mask of the symbols in bitmap word 'word' which are less than 'n': */
+
+    if (n >= (word +1) << 6)   return ~0ULL;
+    if (n <=  word     << 6)   return 0;
+    return (1ULL << (n & 63)) - 1;
+}
+
+static inline uint unexcluded_below(   Excluded_Symbols* excl,   uint n   ) {
+
+    /* Number of symbols less than 'n' not in 'excl': */
+
+    return __builtin_popcountll( ~excl->bits[0] & symbols_below( n, 0 ) )
+         + __builtin_popcountll( ~excl->bits[1] & symbols_below( n, 1 ) )
+         + __builtin_popcountll( ~excl->bits[2] & symbols_below( n, 2 ) )
+         + __builtin_popcountll( ~excl->bits[3] & symbols_below( n, 3 ) );
+}
+
+static inline uint select_bit(   u64 bits,   uint n   ) {
+
+    /* Position of the n-th (from 0) set bit in 'bits': */
+
+#ifdef __BMI2__
+    return __builtin_ctzll( _pdep_u64( 1ULL << n, bits ) );
+#else
+    uint pos = 0;
+    uint c;
+    c = __builtin_popcountll( bits & 0xFFFFFFFFULL );   if (n >= c) {   n -= c;   bits >>= 32;   pos += 32;   }
+    c = __builtin_popcountll( bits & 0x0000FFFFULL );   if (n >= c) {   n -= c;   bits >>= 16;   pos += 16;   }
+    c = __builtin_popcountll( bits & 0x000000FFULL );   if (n >= c) {   n -= c;   bits >>=  8;   pos +=  8;   }
+    while (n--)   bits &= bits - 1;
+    return pos + __builtin_ctzll( bits );
+#endif
+}
+
 void order_minus_one_Encode(   uint symbol,   uint char_count,   Arith* arith,   Excluded_Symbols* excl   ) {
 
     assert( ! excluded_symbols_Contains( excl, symbol ) );
 
-    {   uint low = 0;
-        uint i;
-        for (i = 0;   i < symbol;   i++) {
-            if (!excluded_symbols_Contains( excl, i ))  ++low;
-        }
-        {   uint total = low +1;
-            for (i = symbol +1;   i < char_count;   i++) {
-                if (!excluded_symbols_Contains( excl, i ))   ++total;
-            }
+    {   uint low   = unexcluded_below( excl, symbol     );
+        uint total = unexcluded_below( excl, char_count );
 
-            arith_Encode_1_Of_N( arith, low, low +1, total );
-        }
+        arith_Encode_1_Of_N( arith, low, low +1, total );
     }
 }
 
 uint order_minus_one_Decode(   uint char_count,   Arith* arith,   Excluded_Symbols* excl   ) {
 
-    uint total = 0;
-    {   uint i;
-        for (i = 0;   i < char_count;   i++) {
-            if (!excluded_symbols_Contains( excl, i ))   ++total;
-        }
-    }
+    uint total = unexcluded_below( excl, char_count );
 
     {   uint target = arith_Get_1_Of_N( arith, total );
 
         arith_Decode_1_Of_N( arith, target, target +1, total );
 
-        {   uint symbol;
-            for (symbol = 0;   ;   ++symbol, --target) {
-                while (excluded_symbols_Contains( excl, symbol ))   ++symbol;
-                if (!target)   return symbol;
+        /* Find the word holding the target'th */
+        /* unexcluded symbol, then the symbol: */
+        {   uint word;
+            for (word = 0;   ;   ++word) {
+                u64  unexcluded = ~excl->bits[ word ];
+                uint count      = __builtin_popcountll( unexcluded );
+                if (target < count)   return (word << 6) + select_bit( unexcluded, target );
+                target -= count;
             }
         }
     }
@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "phase.h"
+
+/* See phase.h. */
+
+#ifdef PZIP_PHASES
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+u64  phase_ticks[ PHASES ];
+int  phase_current     = PHASE_OTHER;
+u64  phase_switched_at = 0;
+bool phase_counting    = FALSE;
+
+static const char* phase_name[ PHASES ] = {
+    "other",
+    "trie_Fill_Active_Contexts",
+    "deterministic_Encode/Decode",
+    "deterministic_Update",
+    "repeat",
+    "choose_context",
+    "context_Encode/Decode",
+    "context_Update",
+    "arithmetic coding",
+};
+
+/* To turn ticks into seconds: */
+static struct timespec started_at;
+
+static double secs_since_start( void ) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (ts.tv_sec - started_at.tv_sec) + (ts.tv_nsec - started_at.tv_nsec) * 1e-9;
+}
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+u64 phase_Now( void ) {   return __builtin_ia32_rdtsc();   }
+#else
+u64 phase_Now( void ) {
+    /* No cycle counter, so count nanoseconds: */
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+int phase_Enter( int phase ) {
+    u64 now = phase_Now();
+    int was = phase_current;
+    if (phase_counting)   phase_Count( was );
+    phase_ticks[ was ] += now - phase_switched_at;
+    phase_switched_at   = now;
+    phase_current       = phase;
+    return was;
+}
+
+/*****************************************************************/
+/* Hardware counters, for -v -v.  Each counter is opened on its  */
+/* own rather than as a group, so that a CPU or kernel lacking   */
+/* one (dTLB misses are the usual casualty) costs us just that   */
+/* one.  If there are more than the PMU can hold at once, the    */
+/* kernel takes turns with them;  phase_Report() says so.        */
+/*****************************************************************/
+
+enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_LLC_MISSES,
+    COUNTER_DTLB_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTERS
+};
+
+static u64  phase_counts[ PHASES ][ COUNTERS ];
+static u64  counter_last[ COUNTERS ];
+static bool counters_tried = FALSE;
+
+#ifdef __linux__
+
+static const struct {
+    u32 type;
+    u64 config;
+} counter_event[ COUNTERS ] = {
+    { PERF_TYPE_HARDWARE,   PERF_COUNT_HW_CPU_CYCLES     },
+    { PERF_TYPE_HARDWARE,   PERF_COUNT_HW_INSTRUCTIONS   },
+    { PERF_TYPE_HARDWARE,   PERF_COUNT_HW_CACHE_MISSES   },
+    { PERF_TYPE_HW_CACHE,   PERF_COUNT_HW_CACHE_DTLB
+                        |   PERF_COUNT_HW_CACHE_OP_READ        <<  8
+                        |   PERF_COUNT_HW_CACHE_RESULT_MISS    << 16 },
+    { PERF_TYPE_HARDWARE,   PERF_COUNT_HW_BRANCH_MISSES  },
+};
+
+static int                          counter_fd[   COUNTERS ];
+static struct perf_event_mmap_page* counter_page[ COUNTERS ];   /* NULL if we couldn't map it. */
+static int                          counter_errno;             /* Why the first failure failed. */
+
+static void open_counters( void ) {
+    long page_size = sysconf( _SC_PAGESIZE );
+    int  c;
+
+    for (c = 0;   c < COUNTERS;   ++c) {
+        struct perf_event_attr attr;
+        memset( &attr, 0, sizeof( attr ) );
+        attr.size           = sizeof( attr );
+        attr.type           = counter_event[c].type;
+        attr.config         = counter_event[c].config;
+        attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+
+        counter_fd[c]   = syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 );
+        counter_page[c] = NULL;
+        if (counter_fd[c] < 0) {
+            if (!counter_errno)   counter_errno = errno;
+            continue;
+        }
+        phase_counting = TRUE;
+
+        /* The first page of the ring buffer tells us */
+        /* how to read the counter without a syscall: */
+        {   void* page = mmap( NULL, page_size, PROT_READ, MAP_SHARED, counter_fd[c], 0 );
+            if (page != MAP_FAILED)   counter_page[c] = page;
+        }
+    }
+}
+
+/* Returns value, and via 'running' the fraction */
+/* of the time it has actually been counting:    */
+static u64 read_counter_slowly(   int c,   double* running   ) {
+    u64 value[ 3 ];   /* Count, time enabled, time running. */
+    if (read( counter_fd[c], value, sizeof( value ) ) != sizeof( value ))   return counter_last[c];
+    if (running)   *running = value[1] ? (double)value[2] / value[1] : 1.0;
+    return value[0];
+}
+
+static u64 read_counter( int c ) {
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+    /* See the comments on perf_event_mmap_page in <linux/perf_event.h>. */
+    volatile struct perf_event_mmap_page* pc = counter_page[c];
+    if (pc) {
+        for (;;) {
+            u32 seq   = pc->lock;
+            u32 index;
+            u64 count;
+            i64 pmc;
+            __asm__ __volatile__( "" ::: "memory" );
+            index = pc->index;
+            if (!pc->cap_user_rdpmc || !index)   break;   /* Not now, or not ever. */
+            count = pc->offset;
+            pmc   = __builtin_ia32_rdpmc( index -1 );
+            __asm__ __volatile__( "" ::: "memory" );
+            if (pc->lock == seq) {
+                /* Sign-extend the pmc_width-bit counter: */
+                pmc <<= 64 - pc->pmc_width;
+                pmc >>= 64 - pc->pmc_width;
+                return count + pmc;
+            }
+        }
+    }
+#endif
+
+    return read_counter_slowly( c, NULL );
+}
+
+void phase_Count( int phase ) {
+    int c;
+    for (c = 0;   c < COUNTERS;   ++c) {
+        if (counter_fd[c] >= 0) {
+            u64 now = read_counter( c );
+            phase_counts[ phase ][ c ] += now - counter_last[c];
+            counter_last[c]             = now;
+        }
+    }
+}
+
+#else
+
+static void open_counters( void ) {}
+void phase_Count( int phase ) {}
+
+#endif /* __linux__ */
+
+void phase_Start( void ) {
+
+    memset( phase_ticks,  0, sizeof( phase_ticks  ) );
+    memset( phase_counts, 0, sizeof( phase_counts ) );
+
+    if (verbose > 1 && !counters_tried) {
+        counters_tried = TRUE;
+        open_counters();
+    }
+    phase_current = PHASE_OTHER;
+    if (phase_counting)   phase_Count( PHASE_OTHER );   /* Sets counter_last. */
+    memset( phase_counts, 0, sizeof( phase_counts ) );
+
+    clock_gettime( CLOCK_MONOTONIC, &started_at );
+    phase_switched_at = phase_Now();
+}
+
+static void report_counters(   const char* what,   uint bytes   ) {
+
+#ifdef __linux__
+    static const char* heading[ COUNTERS ] = { "cyc/byte", "IPC", "LLC/byte", "dTLB/byte", "brmis/byte" };
+    int p;
+    int c;
+
+    if (!phase_counting) {
+        fprintf( stderr, "%s: no hardware counters (perf_event_open: %s)\n", what, strerror( counter_errno ) );
+        return;
+    }
+
+    fprintf( stderr, "%-30s", what );
+    for (c = 0;   c < COUNTERS;   ++c)   fprintf( stderr, " %10s", heading[c] );
+    fprintf( stderr, "\n" );
+
+    for (p = 0;   p < PHASES;   ++p) {
+        u64* n = phase_counts[p];
+        fprintf( stderr, "  %-28s", phase_name[p] );
+        for (c = 0;   c < COUNTERS;   ++c) {
+            if (counter_fd[c] < 0) {
+                fprintf( stderr, " %10s", "-" );
+            } else if (c == COUNTER_INSTRUCTIONS) {
+                /* IPC is meaningless without cycles: */
+                if (counter_fd[ COUNTER_CYCLES ] < 0 || !n[ COUNTER_CYCLES ])   fprintf( stderr, " %10s", "-" );
+                else   fprintf( stderr, " %10.2f", (double)n[c] / n[ COUNTER_CYCLES ] );
+            } else {
+                fprintf( stderr, " %10.3f", (double)n[c] / bytes );
+            }
+        }
+        fprintf( stderr, "\n" );
+    }
+
+    for (c = 0;   c < COUNTERS;   ++c) {
+        double running = 1.0;
+        if (counter_fd[c] < 0) {
+            fprintf( stderr, "  (%s: not available)\n", heading[c] );
+            continue;
+        }
+        read_counter_slowly( c, &running );
+        if (running < 0.99) {
+            fprintf( stderr, "  (%s: multiplexed, counted only %.0f%% of the time)\n", heading[c], 100.0 * running );
+        }
+    }
+#endif
+}
+
+void phase_Report(   const char* what,   uint bytes   ) {
+
+    u64    total = 0;
+    double secs;
+    double secs_per_tick;
+    int    p;
+
+    phase_Enter( phase_current );   /* Bring the current phase up to date. */
+    secs = secs_since_start();
+
+    for (p = 0;   p < PHASES;   ++p)   total += phase_ticks[p];
+    if (!total || !bytes)   return;
+    secs_per_tick = secs / total;
+
+    fprintf( stderr, "%-30s %9s %9s %7s\n", what, "secs", "ns/byte", "% run" );
+    for (p = 0;   p < PHASES;   ++p) {
+        double s = phase_ticks[p] * secs_per_tick;
+        fprintf( stderr, "  %-28s %9.3f %9.1f %6.1f%%\n", phase_name[p], s, s * 1e9 / bytes, 100.0 * phase_ticks[p] / total );
+    }
+    fprintf( stderr, "  %-28s %9.3f %9.1f %6.1f%%\n", "total", secs, secs * 1e9 / bytes, 100.0 );
+
+    if (verbose > 1)   report_counters( what, bytes );
+}
+
+#endif /* PZIP_PHASES */
@@ -0,0 +1,92 @@
+#ifndef PHASE_H
+#define PHASE_H
+
+#include "inc.h"
+
+/*****************************************************************/
+/* Where does the time go?  Built with -DPZIP_PHASES, we charge  */
+/* every cycle of pzip_Encode()/pzip_Decode() to one of the      */
+/* phases below, and -v prints the breakdown.  Unlike -pg this   */
+/* leaves the code as the optimizer would have it, so it works   */
+/* on production builds:                                         */
+/*                                                               */
+/*   make CFLAGS='$(PRODUCTIONCFLAGS) -DPZIP_PHASES'             */
+/*                                                               */
+/* There is always exactly one current phase.  phase_Enter()     */
+/* reads the clock once, charges the time since the last switch  */
+/* to the phase we are leaving, and returns it so that the       */
+/* caller can switch back.  Nested phases thus come out net:     */
+/* arithmetic coding done inside context_Encode() counts as      */
+/* PHASE_ARITH, not PHASE_CONTEXT_CODE.                          */
+/*                                                               */
+/* Each switch costs a rdtsc, a couple of dozen cycles, and we   */
+/* switch several times a byte, so an instrumented run is a      */
+/* quarter or so slower:  Compare phases with one another, not   */
+/* with an uninstrumented run.  Without PZIP_PHASES it all       */
+/* compiles away to nothing.                                     */
+/*                                                               */
+/* Since we are mostly waiting on memory, time alone says little */
+/* about why a phase is slow.  With -v -v we also open Linux     */
+/* perf_event counters for cycles, instructions, LLC misses,     */
+/* dTLB misses and branch misses, charge them to phases the same */
+/* way, and report IPC and events per byte.  We read them with   */
+/* rdpmc where the kernel allows it, else by read(), which is    */
+/* much slower.  Counters we can't open (no PMU in a VM, a high  */
+/* perf_event_paranoid) are reported as such and skipped.        */
+/*****************************************************************/
+
+enum {
+    PHASE_OTHER,              /* Anything not below.                            */
+    PHASE_TRIE,               /* trie_Fill_Active_Contexts().                   */
+    PHASE_DET_CODE,           /* deterministic_{Run_,}{En,De}code().            */
+    PHASE_DET_UPDATE,         /* deterministic_Update(), deterministic_Seed().  */
+    PHASE_REPEAT,             /* repeat.c, if PZIP_OPTION_LONG_REPEATS.         */
+    PHASE_CHOOSE,             /* choose_context() in pzip.c.                    */
+    PHASE_CONTEXT_CODE,       /* context_Encode/Decode(), order -1.             */
+    PHASE_CONTEXT_UPDATE,     /* context_Update_Active_Contexts().              */
+    PHASE_ARITH,              /* arith_{En,De}code_*(), arith_Get_1_Of_N().     */
+    PHASES
+};
+
+#ifdef PZIP_PHASES
+
+extern u64 phase_ticks[ PHASES ];         /* Time charged to each phase so far. */
+extern int phase_current;
+extern u64 phase_switched_at;
+extern bool phase_counting;               /* TRUE iff phase_Count() has counters to read. */
+
+u64  phase_Now(     void        );
+int  phase_Enter(   int phase   );
+void phase_Count(   int phase   );   /* Charge perf_event counts to 'phase'.   */
+void phase_Start(   void        );   /* Zero the counts; we are in PHASE_OTHER. */
+void phase_Report(  const char* what,   uint bytes   );   /* To stderr, for -v. */
+
+/* Evaluate 'expr' in 'phase': */
+#define PHASED( phase, expr )        ({ int phase_was_ = phase_Enter( phase );   __typeof__( expr ) phase_result_ = (expr);   phase_Enter( phase_was_ );   phase_result_; })
+#define PHASED_VOID( phase, expr )   do { int phase_was_ = phase_Enter( phase );   (expr);   phase_Enter( phase_was_ ); } while (0)
+
+#ifdef __GNUC__
+#if defined( __x86_64__ ) || defined( __i386__ )
+extern inline u64 phase_Now( void ) {   return __builtin_ia32_rdtsc();   }
+#endif
+extern inline int phase_Enter( int phase ) {
+    u64 now = phase_Now();
+    int was = phase_current;
+    if (phase_counting)   phase_Count( was );
+    phase_ticks[ was ] += now - phase_switched_at;
+    phase_switched_at   = now;
+    phase_current       = phase;
+    return was;
+}
+#endif /* __GNUC__ */
+
+#else
+
+#define PHASED( phase, expr )        (expr)
+#define PHASED_VOID( phase, expr )   (expr)
+#define phase_Start()                ((void)0)
+#define phase_Report( what, bytes )  ((void)0)
+
+#endif /* PZIP_PHASES */
+
+#endif /* PHASE_H */
@@ -1,26 +1,14 @@
+#define POOL_C
 #include "inc.h"
 #include "pool.h"
 #include "safe.h"
+#include "huge.h"
 
-typedef struct Block {
-    struct Block* next;
-    char*         base;
-    char*         ptr;
-    long          length;
-    long          free;
-} Block;
-
-struct Pool {
-    long   hunk_length;
-
-    Block* this_block;
-    Block* block;
-    void** freed_hunks;
-
-    long   num_auto_extend_items;
-    long   freed_hunk_count;
-    long   freed_hunk_count_max;
-    long   active_item_count;
+struct Pool_Block {
+    Pool_Block* next;
+    u08*        base;
+    long        length;
+    int         idle_resets;    /* On 'spare', resets since last used. */
 };
 
 /*
@@ -30,153 +18,123 @@ struct Pool {
  *    does auto-extending of memory space in case you use more space than
  *     expected or if you don't know how much you will need
  *
+ *  See pool.h for the hunk layout and the inlined fast paths.
  */
 
-static Pool* extend( Pool* pool, long hunk_count ) {
-    Block* block = pool->block;
+#define CACHE_LINE (64)
 
-    while (block) {
-        if (block->free > pool->hunk_length) {
-            pool->this_block = block;
-            return pool;
-        }
-        block = block->next;
-    }
-
-    block = safe_Malloc( sizeof( Block ) );
-    block->length = hunk_count * pool->hunk_length;
-    block->free   = block->length;
+/* Hysteresis:  A spare block goes back to the system only */
+/* once this many pool_Reset()s have passed without its    */
+/* being needed, so a Pool which keeps emptying and        */
+/* refilling to about the same size never remaps anything: */
+#define IDLE_RESETS_BEFORE_RELEASE (2)
 
-    block->base = safe_Malloc( block->length );
-    block->ptr  = block->base;
-    block->next = pool->block;
-    pool->block = block;
+static long padded_size( long length ) {
+    long padded = sizeof( void* );      /* Room for the free_list link. */
 
-    pool->this_block = block;
+    if (length > CACHE_LINE)   return ((length -1) / CACHE_LINE + 1) * CACHE_LINE;
 
-    return pool;
+    while (padded < length)   padded <<= 1;
+    return padded;
 }
 
-#define padded_size(a) ((((a)-1)/4 + 1)*4)
-
+static void add_block( Pool* pool, long hunk_count ) {
+    Pool_Block* block = safe_Malloc( sizeof( Pool_Block ) );
 
-/*
- * hunk_length is forced to be a multiple of 4
- */
-Pool* pool_Create( long hunk_length, long NumHunks, long num_auto_extend_items ) {
-
-    Pool* pool = safe_Malloc( sizeof( Pool ));
-    pool->hunk_length  = padded_size( hunk_length );
-    pool->this_block   = NULL;
-    pool->block        = NULL;
-
-    pool->freed_hunk_count      = 0;
-    pool->freed_hunk_count_max  = 16;
-    pool->num_auto_extend_items = num_auto_extend_items;
-    pool->active_item_count     = 0;
-
-    pool->freed_hunks = safe_Malloc( pool->freed_hunk_count_max * sizeof(void*) );
+    /* huge_Calloc() aligns to at least a cache line: */
+    block->length = hunk_count * pool->hunk_length;
+    block->base   = huge_Calloc( block->length );
+    block->idle_resets = 0;
+    block->next   = pool->block;
+    pool->block   = block;
 
-    return extend( pool, NumHunks );
+    pool->next    = block->base;
+    pool->end     = block->base + block->length;
 }
 
-void pool_Destroy( Pool* pool ) {
-    Block* this;
-    Block* next;
-
-    if (pool == NULL)  return;
+void* pool_Extend( Pool* pool ) {
+    void* hunk;
 
-    for (this = pool->block;  this;   this = next) {
-        free( this->base );
-        next = this->next;
-        free( this );
+    if (pool->spare) {
+        Pool_Block* block = pool->spare;
+        pool->spare = block->next;
+        block->next = pool->block;
+        pool->block = block;
+        pool->next  = block->base;
+        pool->end   = block->base + block->length;
+    } else {
+        add_block( pool, pool->num_auto_extend_items );
     }
 
-    free( pool->freed_hunks );
-    free( pool               );
+    hunk        = pool->next;
+    pool->next += pool->hunk_length;
+    return hunk;
 }
 
-void* pool_Get_Hunk( Pool* pool ) {
-    void*  ret;
-    Block* block;
-
-    if (pool->freed_hunk_count > 0) {
-        --pool->freed_hunk_count;
-        ret = pool->freed_hunks[ pool->freed_hunk_count ];
-
-        pool->active_item_count++;
-
-        memset( ret, 0, pool->hunk_length );
-
-        return ret;
-    }
+Pool* pool_Create( long hunk_length, long hunk_count, long num_auto_extend_items, bool zero ) {
 
-    if (!(block = pool->this_block)) {
-        return NULL;
-    }
-
-    if (block->free < pool->hunk_length) {
-        pool = extend( pool, pool->num_auto_extend_items );
-        block = pool->this_block;
-    }
-
-    ret = (void*) block->ptr;
-
-    block->free -= pool->hunk_length;
-    block->ptr  += pool->hunk_length;
-
-    memset( ret, 0, pool->hunk_length );
-
-    ++ pool->active_item_count;
+    Pool* pool = new( Pool );
+    pool->hunk_length           = padded_size( hunk_length );
+    pool->num_auto_extend_items = num_auto_extend_items;
+    pool->zero                  = zero;
 
-    return ret;
+    add_block( pool, hunk_count );
+    return pool;
 }
 
-static bool free_hunk( Pool* pool, void* hunk ) {
-
-    if ( pool->freed_hunk_count >= pool->freed_hunk_count_max ) {
-        void** newFreedHunks = safe_Malloc( (pool->freed_hunk_count_max << 1) * sizeof(void*) );
-        memcpy( newFreedHunks, pool->freed_hunks, pool->freed_hunk_count_max * sizeof(void*) );
-        free( pool->freed_hunks );
-        pool->freed_hunks = newFreedHunks;
-        pool->freed_hunk_count_max <<= 1;
+void pool_Reset( Pool* pool ) {
+
+    /* Spares still unused since the last reset have */
+    /* now sat out another whole cycle:              */
+    {   Pool_Block** link = &pool->spare;
+        while (*link) {
+            Pool_Block* block = *link;
+            if (++ block->idle_resets >= IDLE_RESETS_BEFORE_RELEASE) {
+                *link = block->next;
+                huge_Free( block->base );
+                free( block );
+            } else {
+                link = &block->next;
+            }
+        }
     }
 
-    pool->freed_hunks[ pool->freed_hunk_count ] = hunk;
-
-    ++pool->freed_hunk_count;
-    --pool->active_item_count;
+    /* Go back to carving from the oldest block, the */
+    /* one pool_Create() made, and set the rest      */
+    /* aside for pool_Extend() to reuse.  Their      */
+    /* pages stay mapped; we needn't clear them:     */
+    while (pool->block->next) {
+        Pool_Block* block = pool->block;
+        pool->block        = block->next;
+        block->next        = pool->spare;
+        block->idle_resets = 0;
+        pool->spare        = block;
+    }
 
-    return 1;
+    pool->free_list         = NULL;
+    pool->next              = pool->block->base;
+    pool->end               = pool->block->base + pool->block->length;
+    pool->active_item_count = 0;
 }
 
-void* pool_Auto_Get_Hunk( Pool** pool,  int* hunk_count,   int hunk_size ) {
-    void* hunk;
+static void free_blocks( Pool_Block* this ) {
+    Pool_Block* next;
 
-    if (!*pool) {
-        *hunk_count = 0;
-        *pool = pool_Create( hunk_size, 100 * 4096, 100 * 1024 );    assert( *pool );
+    for (;   this;   this = next) {
+        huge_Free( this->base );
+        next = this->next;
+        free( this );
     }
-    assert( hunk_size == (*pool)->hunk_length );
-
-    hunk = pool_Get_Hunk( *pool );
-
-    *hunk_count += 1;
-
-    return hunk;
 }
 
-void  pool_Auto_Free_Hunk( Pool** pool, int* hunk_count, void* hunk ) {
-    assert( *pool && *hunk_count >= 1 );
+void pool_Destroy( Pool* pool ) {
 
-    free_hunk( *pool, hunk );
+    if (pool == NULL)  return;
 
-    *hunk_count -= 1;
+    free_blocks( pool->block );
+    free_blocks( pool->spare );
 
-    if (*hunk_count == 0) {
-        pool_Destroy( *pool );
-        *pool = NULL;
-    }
+    free( pool );
 }
 
 void pool_Auto_Destroy( Pool** pool,int* hunk_count ) {
@@ -3,14 +3,108 @@
 
 #include "inc.h"
 
-typedef struct Pool Pool;
+/********************************************************************/
+/* A Pool hands out fixed-size "hunks" of memory, carved in order   */
+/* from big blocks.  A freed hunk goes on 'free_list', linked       */
+/* through its own first word, and is handed out again before any   */
+/* fresh space.  Nothing ever walks the hunks, so getting and       */
+/* freeing one are a handful of instructions, inlined below; only   */
+/* running out of block space (pool_Extend()) costs a call.         */
+/*                                                                  */
+/* Hunk lengths are rounded up to a power of two up to 64 bytes,    */
+/* else to a multiple of 64, and blocks are cache-line aligned, so  */
+/* no hunk straddles more cache lines than it must.  Hunks come     */
+/* back zeroed only if the Pool was created with 'zero' set.        */
+/*                                                                  */
+/* pool_Reset() keeps all blocks but the first on 'spare' rather    */
+/* than freeing them, and pool_Extend() takes from there first.     */
+/* Only a spare which goes unused for a couple of resets in a row   */
+/* is released, so emptying and refilling a Pool costs no mapping.  */
+/********************************************************************/
+
+typedef struct Pool_Block Pool_Block;
+typedef struct Pool       Pool;
+
+struct Pool {
+    void*       free_list;              /* Freed hunks, linked through their first word. */
+    u08*        next;                   /* Fresh space in the newest block ...           */
+    u08*        end;                    /* ... runs from 'next' up to here.              */
+    long        hunk_length;
+    long        active_item_count;
+    bool        zero;
+
+    Pool_Block* block;                  /* All our blocks in use, newest first.          */
+    Pool_Block* spare;                  /* Blocks pool_Reset() took back, for reuse.     */
+    long        num_auto_extend_items;  /* Hunks per block after the first.              */
+};
 
 void* pool_Auto_Get_Hunk(  Pool** pool, int* hunk_count, int hunk_size );
 void  pool_Auto_Free_Hunk( Pool** pool, int* hunk_count, void* hunk   );
 void  pool_Auto_Destroy(  Pool** pool, int* hunk_count               );
 
-extern Pool* pool_Create( long hunk_length, long hunk_count, long num_auto_extend_items );
+extern Pool* pool_Create( long hunk_length, long hunk_count, long num_auto_extend_items, bool zero );
 extern void  pool_Destroy(  Pool* pool ); /* ok to call this with pool == NULL */
+extern void  pool_Reset(    Pool* pool ); /* Free all hunks in O(1), keeping the memory. */
 extern void* pool_Get_Hunk( Pool* pool );
+extern void  pool_Free_Hunk( Pool* pool, void* hunk );
+extern void* pool_Extend(   Pool* pool ); /* Slow path of pool_Get_Hunk(). */
+
+/* pool.c defines POOL_C to get the out-of-line */
+/* copies of these for non-inlined calls:       */
+#if defined( __GNUC__ ) || defined( POOL_C )
+#ifdef POOL_C
+#define POOL_INLINE
+#else
+#define POOL_INLINE extern inline
+#endif
+
+POOL_INLINE void* pool_Get_Hunk( Pool* pool ) {
+    void* hunk = pool->free_list;
+
+    if (hunk) {
+        pool->free_list = *(void**)hunk;
+    } else if (pool->next < pool->end) {
+        hunk        = pool->next;
+        pool->next += pool->hunk_length;
+    } else {
+        hunk        = pool_Extend( pool );
+    }
+    ++ pool->active_item_count;
+
+    if (pool->zero)   memset( hunk, 0, pool->hunk_length );
+    return hunk;
+}
+
+POOL_INLINE void pool_Free_Hunk( Pool* pool, void* hunk ) {
+    *(void**)hunk   = pool->free_list;
+    pool->free_list = hunk;
+    -- pool->active_item_count;
+}
+
+/* The "Auto" Pools are created on first use.  When the   */
+/* last hunk is freed we rewind rather than destroy the   */
+/* Pool, keeping its blocks as spares, so that a Pool     */
+/* which keeps emptying and refilling doesn't thrash the  */
+/* allocator:                                             */
+
+POOL_INLINE void* pool_Auto_Get_Hunk( Pool** pool,  int* hunk_count,   int hunk_size ) {
+    if (!*pool) {
+        *hunk_count = 0;
+        *pool = pool_Create( hunk_size, 100 * 4096, 100 * 1024, FALSE );
+    }
+    ++ *hunk_count;
+    return pool_Get_Hunk( *pool );
+}
+
+POOL_INLINE void pool_Auto_Free_Hunk( Pool** pool, int* hunk_count, void* hunk ) {
+    assert( *pool && *hunk_count >= 1 );
+
+    pool_Free_Hunk( *pool, hunk );
+
+    if (!-- *hunk_count)   pool_Reset( *pool );
+}
+
+#undef POOL_INLINE
+#endif /* __GNUC__ || POOL_C */
 
 #endif /* POOL_H */
@@ -9,43 +9,90 @@
 #include "excluded_symbols.h"
 #include "order-1.h"
 #include "config.h"
+#include "lookahead.h"
+#include "repeat.h"
+#include "huge.h"
+#include "phase.h"
+
+bool pzip_lookahead_thread = FALSE;
+u32  pzip_options          = 0;
 
 typedef struct {
 
+    Trie*    trie;      /* Also published as 'trie', see context.h. */
     Arith*   arith;
     Excluded_Symbols* excluded_symbols;
     See*     see;
     Det*     det;
+    Repeat*  repeat;    /* NULL unless PZIP_OPTION_LONG_REPEATS. */
 } Pzip;
 
+/* We build one model and keep it for every file we  */
+/* code, resetting it in between.  Each reset just   */
+/* rewinds the arenas the model lives in, so the     */
+/* memory stays mapped and warm.  The model owns all */
+/* of them, through its parts:                       */
+static Pzip* model = NULL;
+
 static Pzip* pzip_create( void ) {
 
-    Pzip*  pzip = new( Pzip );
+    bool   defer  = (pzip_options & PZIP_OPTION_DEFER_CONTEXTS) != 0;
+    bool   chains = (pzip_options & PZIP_OPTION_DET_CHAINS)     != 0;
+    bool   repeat = (pzip_options & PZIP_OPTION_LONG_REPEATS)   != 0;
+    bool   runs   = (pzip_options & PZIP_OPTION_MATCH_RUNS)     != 0;
+    bool   coder  = (pzip_options & PZIP_OPTION_RANGE_CODER)    != 0;
+    uint   window = (pzip_options & PZIP_OPTION_DET_WINDOW) >> PZIP_OPTION_DET_WINDOW_SHIFT;
+    Pzip*  pzip;
+
+    if (!window)   window = DETERMINISTIC_WINDOW_BITS;
+
+    if (model) {
+        trie_Reset(          model->trie, defer    );
+        see_Reset(           model->see            );
+        deterministic_Reset( model->det,   window,   chains,   runs   );
+        arith_Use_Range_Coder( model->arith, coder );
+        if (!repeat) {
+            repeat_Destroy( model->repeat );
+            model->repeat = NULL;
+        } else if (!model->repeat) {
+            model->repeat = repeat_Create();
+        } else {
+            repeat_Reset( model->repeat );
+        }
+        return model;
+    }
 
-    trie                   = trie_Create();
+    pzip = new( Pzip );
+
+    pzip->trie             = trie_Create( defer );
+    trie                   = pzip->trie;
 
     pzip->arith            = arith_Create();
+    arith_Use_Range_Coder( pzip->arith, coder );
     pzip->excluded_symbols = excluded_symbols_Create();
     pzip->see              = see_Create();
-    pzip->det          =     deterministic_Create();
+    pzip->det          =     deterministic_Create( window, chains, runs );
+    pzip->repeat       =     repeat ? repeat_Create() : NULL;
 
-    return pzip;
+    return model = pzip;
 }
 
-static void pzip_destroy( Pzip* pzip ) {
+void pzip_Release( void ) {
+
+    Pzip* pzip = model;
+
+    if (!pzip)   return;
+    model = NULL;
 
     excluded_symbols_Destroy( pzip->excluded_symbols );
     arith_Destroy(   pzip->arith   );
     see_Destroy(     pzip->see     );
 
-    trie_Destroy( trie );
-
-    /* Doing this is much faster, but ruins any encapsulation      */
-    /* we might have had : eg. we destroy the context trie         */
-    /* for ALL pzip objects:                                       */
-    context_Destroy_All_Contexts();
+    trie_Destroy(    pzip->trie    );
+    trie = NULL;
 
     deterministic_Destroy( pzip->det );
+    repeat_Destroy( pzip->repeat );
 
     destroy( pzip );
 }
@@ -120,8 +167,6 @@ static int choose_context(   Context* context[],   int contexts,   u32 key,   Ex
     /*********************************************************************/
 }
 
-Contexts active_contexts;
-
 uint pzip_Encode(   u08* input_buf,   uint input_len,   u08* encode_buf   ) {
 
     /* This is the top-level compression function.                             */
@@ -133,6 +178,9 @@ uint pzip_Encode(   u08* input_buf,   uint input_len,   u08* encode_buf   ) {
     int num_tried_by_order[ PZIP_ORDER +1 ];
     int num_coded_by_order[ PZIP_ORDER +1 ];
     int num_coded_det = 0;
+    int num_coded_rep = 0;
+    int num_coded_run = 0;
+    int num_hinted    = 0;
 
     clock_t began_at = clock();
 
@@ -142,6 +190,8 @@ uint pzip_Encode(   u08* input_buf,   uint input_len,   u08* encode_buf   ) {
     u08* input_ptr      =  input_buf;
     u08* input_buf_end  =  input_buf + input_len;
 
+    Lookahead* lookahead = NULL;
+
     assert( PZIP_SEED_BYTES > 0 );
 
     /* Seed a preamble: */
@@ -149,57 +199,86 @@ uint pzip_Encode(   u08* input_buf,   uint input_len,   u08* encode_buf   ) {
     memset( input_ptr - PZIP_MAX_CONTEXT_LEN, PZIP_SEED_BYTE, PZIP_MAX_CONTEXT_LEN );
     input_ptr  += PZIP_SEED_BYTES;
 
+    /* The helper may only start reading    */
+    /* input once the preamble is in place: */
+    if (pzip_lookahead_thread && input_ptr < input_buf_end) {
+        lookahead = lookahead_Create( input_ptr, input_buf_end );
+    }
+
     arith_Start_Encoding( arith, encode_buf + PZIP_SEED_BYTES );
 
     memset( num_chose_loe,      0, (PZIP_ORDER +1) * sizeof(int) );
     memset( num_tried_by_order, 0, (PZIP_ORDER +1) * sizeof(int) );
     memset( num_coded_by_order, 0, (PZIP_ORDER +1) * sizeof(int) );
 
+    phase_Start();
     while (input_ptr < input_buf_end) {
 
         int symbol = *input_ptr;                      /* Current symbol to encode.             */
         u32 key  = getu32( input_ptr -4 );        /* Last four chars seen on input stream. */
 
-        trie_Fill_Active_Contexts( input_ptr ); /* Must come before det_Enc(), cuz that uses the top Context node */
+        if (PHASED( PHASE_DET_CODE, deterministic_Run_Encode( pzip->det, arith, input_ptr, input_buf, symbol ) )) {
 
-        excluded_symbols_Clear( pzip->excluded_symbols );
+            /* One more byte of a long match;  the */
+            /* rest of the model never sees it:    */
+            ++ num_coded_run;
 
-        if (deterministic_Encode(   pzip->det,   arith,   input_ptr,   input_buf,   symbol,   pzip->excluded_symbols,   active_contexts.c[ PZIP_ORDER ]   )) {
+        } else {
 
-            ++ num_coded_det;
+            /* Must come before det_Enc(), cuz that uses the top Context node: */
+            if (!lookahead) {
+                PHASED_VOID( PHASE_TRIE, trie_Fill_Active_Contexts( input_ptr, NULL ) );
+            } else {
+                Context* hint[ PZIP_ORDER +1 ];
+                bool     have_hints = lookahead_Get_Hints( lookahead, input_ptr, hint );
+                num_hinted += PHASED( PHASE_TRIE, trie_Fill_Active_Contexts( input_ptr, have_hints ? hint : NULL ) );
+            }
+            if (trie->revived_from) {
+                PHASED_VOID( PHASE_DET_UPDATE, deterministic_Seed( pzip->det, trie->revived_from, input_buf, active_contexts.c[ PZIP_ORDER ] ) );
+            }
 
-        } else {
+            excluded_symbols_Clear( pzip->excluded_symbols );
+            see_Forget( pzip->see );   /* trie_Fill_Active_Contexts() may have recycled Contexts. */
 
-            /* Try selected contexts until one encodes 'symbol': */
-            int order = PZIP_ORDER+1;
-            for(order = choose_context( active_contexts.c, order, key, pzip->excluded_symbols, pzip->see ),   ++ num_chose_loe[ order ];   ;
-                order = choose_context( active_contexts.c, order, key, pzip->excluded_symbols, pzip->see )
-            ){
+            if (PHASED( PHASE_DET_CODE, deterministic_Encode(   pzip->det,   arith,   input_ptr,   input_buf,   symbol,   pzip->excluded_symbols,   active_contexts.c[ PZIP_ORDER ]   ) )) {
 
-                ++ num_tried_by_order[ order ];
+                ++ num_coded_det;
 
-                /* Try to code symbol using selected order model: */
-                if (context_Encode( active_contexts.c[order], arith, pzip->excluded_symbols, pzip->see, key, symbol )) {
-                    ++ num_coded_by_order[ order ];
-                    break;
-                }
-                        
-                if (order == 0) {
-                    /* Encode raw with order -1: */
-                    order_minus_one_Encode( symbol, 256, arith, pzip->excluded_symbols );
-                    break;
-                }
-            }
+            } else if (pzip->repeat && PHASED( PHASE_REPEAT, repeat_Encode( pzip->repeat, arith, input_ptr, input_buf, symbol, pzip->excluded_symbols ) )) {
+
+                ++ num_coded_rep;
 
-            /* Did encode, now update the stats: */
-            {   int coded_order = max( order, 0 );
-                for (order = 0;   order <= PZIP_ORDER;   order++) {
-                    context_Update( active_contexts.c[order], symbol, key, pzip->see, coded_order );
+            } else {
+
+                /* Try selected contexts until one encodes 'symbol': */
+                int order = PZIP_ORDER+1;
+                for(order = PHASED( PHASE_CHOOSE, choose_context( active_contexts.c, order, key, pzip->excluded_symbols, pzip->see ) ),   ++ num_chose_loe[ order ];   ;
+                    order = PHASED( PHASE_CHOOSE, choose_context( active_contexts.c, order, key, pzip->excluded_symbols, pzip->see ) )
+                ){
+
+                    ++ num_tried_by_order[ order ];
+
+                    /* Try to code symbol using selected order model: */
+                    if (PHASED( PHASE_CONTEXT_CODE, context_Encode( active_contexts.c[order], arith, pzip->excluded_symbols, pzip->see, key, symbol ) )) {
+                        ++ num_coded_by_order[ order ];
+                        break;
+                    }
+                            
+                    if (order == 0) {
+                        /* Encode raw with order -1: */
+                        PHASED_VOID( PHASE_CONTEXT_CODE, order_minus_one_Encode( symbol, 256, arith, pzip->excluded_symbols ) );
+                        break;
+                    }
                 }
+
+                /* Did encode, now update the stats: */
+                PHASED_VOID( PHASE_CONTEXT_UPDATE, context_Update_Active_Contexts( symbol, key, pzip->see, max( order, 0 ) ) );
             }
+
+            PHASED_VOID( PHASE_DET_UPDATE, deterministic_Update( pzip->det, input_ptr, input_buf, symbol, active_contexts.c[ PZIP_ORDER ] ) );
         }
 
-        deterministic_Update( pzip->det, input_ptr, symbol, active_contexts.c[ PZIP_ORDER ] );
+        if (pzip->repeat)   PHASED_VOID( PHASE_REPEAT, repeat_Update( pzip->repeat, input_ptr, input_buf, symbol ) );
 
         ++ input_ptr;
 
@@ -209,27 +288,29 @@ uint pzip_Encode(   u08* input_buf,   uint input_len,   u08* encode_buf   ) {
             fflush( stderr );
         }
     }
+    lookahead_Destroy( lookahead );
     if (verbose) {
         clock_t clocks  = clock() - began_at;                        /* Do NOT combine   */
         double  secs    = (double)clocks / (double)CLOCKS_PER_SEC;   /* these two lines! */
         fprintf(stderr, "%d/%d\n", input_len, input_len );
         fprintf(stderr,"%s : %f secs = %2.1f %ss/sec\n", "encode", secs, (double)input_len / secs, "byte" );
+        huge_Report();
+        phase_Report( "encode", input_len );
     }
 
 
 
     {   uint encode_len = (arith_Finish_Encoding( arith ) - (encode_buf + PZIP_SEED_BYTES)) + PZIP_SEED_BYTES;
 
-#ifdef OLD
-        pzip_destroy( pzip );
-#endif
-
         /* The arithc has stuffed 1 byte; put it back: */ 
         encode_buf[ PZIP_SEED_BYTES-1 ] = input_buf[ PZIP_SEED_BYTES-1 ];
 
         if (verbose) {
             printf( "o : %7s : %7s : %7s\n", "loe", "tried", "coded" );
             printf("d : %7d : %7d : %7d\n", input_len, input_len, num_coded_det );
+            if (pzip->repeat)            printf( "r : %7d\n", num_coded_rep );
+            if (pzip_options & PZIP_OPTION_MATCH_RUNS)   printf( "f : %7d\n", num_coded_run );
+            if (pzip_lookahead_thread)   printf( "h : %7d\n", num_hinted );
             {   int  i;
                 for (i = PZIP_ORDER+1;   i --> 0;   ) {
                     printf(
@@ -261,46 +342,57 @@ void pzip_Decode(   u08* output_buf,   uint output_len,   u08* encode_buf   ) {
 
     arith_Start_Decoding( arith, encode_buf );
 
+    phase_Start();
     while (output_ptr < output_buf_end) {
 
         int      symbol;
         u32    key      = getu32( output_ptr - 4 );;
 
-        trie_Fill_Active_Contexts( output_ptr );
+        if (!PHASED( PHASE_DET_CODE, deterministic_Run_Decode( pzip->det, arith, output_ptr, output_buf, &symbol ) )) {
 
-        excluded_symbols_Clear( pzip->excluded_symbols );
+            PHASED_VOID( PHASE_TRIE, trie_Fill_Active_Contexts( output_ptr, NULL ) );
+            if (trie->revived_from) {
+                PHASED_VOID( PHASE_DET_UPDATE, deterministic_Seed( pzip->det, trie->revived_from, output_buf, active_contexts.c[ PZIP_ORDER ] ) );
+            }
 
-        if (!deterministic_Decode( pzip->det, arith, output_ptr, output_buf, &symbol, pzip->excluded_symbols, active_contexts.c[PZIP_ORDER] )) {
+            excluded_symbols_Clear( pzip->excluded_symbols );
+            see_Forget( pzip->see );   /* trie_Fill_Active_Contexts() may have recycled Contexts. */
 
-            /* Go down the orders: */
-            int order = PZIP_ORDER+1;
-            for(order = choose_context( active_contexts.c, order, key, pzip->excluded_symbols, pzip->see );   ;
-                order = choose_context( active_contexts.c, order, key, pzip->excluded_symbols, pzip->see )
+            if (!PHASED( PHASE_DET_CODE, deterministic_Decode( pzip->det, arith, output_ptr, output_buf, &symbol, pzip->excluded_symbols, active_contexts.c[PZIP_ORDER] ) )
+            && (!pzip->repeat || !PHASED( PHASE_REPEAT, repeat_Decode( pzip->repeat, arith, output_ptr, output_buf, &symbol, pzip->excluded_symbols ) ))
             ){
 
-                /* Try to coder from order: */
-                if (context_Decode( active_contexts.c[order], arith, pzip->excluded_symbols, pzip->see, key, &symbol )) {
-                    break;
-                }
-                        
-                if (order == 0) {
-                    /* Decode raw with order -1: */
-                    symbol = order_minus_one_Decode( 256, arith, pzip->excluded_symbols );
-                    break;
+                /* Go down the orders: */
+                int order = PZIP_ORDER+1;
+                for(order = PHASED( PHASE_CHOOSE, choose_context( active_contexts.c, order, key, pzip->excluded_symbols, pzip->see ) );   ;
+                    order = PHASED( PHASE_CHOOSE, choose_context( active_contexts.c, order, key, pzip->excluded_symbols, pzip->see ) )
+                ){
+
+                    /* Try to coder from order: */
+                    if (PHASED( PHASE_CONTEXT_CODE, context_Decode( active_contexts.c[order], arith, pzip->excluded_symbols, pzip->see, key, &symbol ) )) {
+                        break;
+                    }
+                            
+                    if (order == 0) {
+                        /* Decode raw with order -1: */
+                        symbol = PHASED( PHASE_CONTEXT_CODE, order_minus_one_Decode( 256, arith, pzip->excluded_symbols ) );
+                        break;
+                    }
                 }
-            }
 
-            /* Did decode, now update the stats: */
-            {   int coded_order = max( order, 0 );
-                for (order = 0;   order <= PZIP_ORDER;   ++order) {
-                    context_Update( active_contexts.c[order], symbol, key, pzip->see, coded_order );
-                }
+                /* Did decode, now update the stats: */
+                PHASED_VOID( PHASE_CONTEXT_UPDATE, context_Update_Active_Contexts( symbol, key, pzip->see, max( order, 0 ) ) );
             }
+
+            PHASED_VOID( PHASE_DET_UPDATE, deterministic_Update( pzip->det, output_ptr, output_buf, symbol, active_contexts.c[ PZIP_ORDER ] ) );
         }
 
-        deterministic_Update( pzip->det, output_ptr, symbol, active_contexts.c[ PZIP_ORDER ] );
+        /* repeat_Update() reads it back: */
+        *output_ptr = symbol;
+
+        if (pzip->repeat)   PHASED_VOID( PHASE_REPEAT, repeat_Update( pzip->repeat, output_ptr, output_buf, symbol ) );
 
-        *output_ptr++ = symbol;
+        ++ output_ptr;
                 
         /* Maybe assure user we haven't crashed: */
         if (verbose   &&   (output_ptr - output_buf) % PZIP_PRINTF_INTERVAL == 0) {
@@ -314,8 +406,9 @@ void pzip_Decode(   u08* output_buf,   uint output_len,   u08* encode_buf   ) {
         double  secs    = (double)clocks / (double)CLOCKS_PER_SEC;   /* these two lines! */
         fprintf(stderr, "%d/%d\n", output_len, output_len );
         fprintf(stderr,"%s : %f secs = %2.1f %ss/sec\n", "decode", secs, (double)output_len / secs, "byte" );
+        huge_Report();
+        phase_Report( "decode", output_len );
     }
 
-    pzip_destroy( pzip );
 }
 
@@ -5,6 +5,22 @@
 
 uint pzip_Encode(   u08* input_buf,   uint input_len,   u08* comp_buf   );
 void pzip_Decode(   u08* input_buf,   uint input_len,   u08* comp_buf   );
+void pzip_Release(  void   );   /* Free the model kept between calls. */
+
+extern bool pzip_lookahead_thread;    /* Encode using a look-ahead helper thread? */
+
+/* Model options recorded in the file header, */
+/* which the decoder must match exactly:      */
+#define PZIP_OPTION_DEFER_CONTEXTS   (1 << 0)    /* See Trie in context.h. */
+#define PZIP_OPTION_DET_CHAINS       (1 << 1)    /* See find_best_node() in deterministic.c. */
+#define PZIP_OPTION_LONG_REPEATS     (1 << 2)    /* See repeat.c. */
+#define PZIP_OPTION_MATCH_RUNS       (1 << 3)    /* See deterministic_Run_Encode(). */
+#define PZIP_OPTION_RANGE_CODER      (1 << 4)    /* See arithmetic-encoding.c. */
+#define PZIP_OPTION_DET_WINDOW       (31 << 8)   /* log2 of deterministic window; 0 means default. */
+#define PZIP_OPTION_DET_WINDOW_SHIFT (8)
+#define PZIP_OPTIONS_KNOWN           (PZIP_OPTION_DEFER_CONTEXTS | PZIP_OPTION_DET_CHAINS | PZIP_OPTION_LONG_REPEATS | PZIP_OPTION_MATCH_RUNS | PZIP_OPTION_RANGE_CODER | PZIP_OPTION_DET_WINDOW)
+
+extern u32 pzip_options;
 
 #endif /* PZIP_H */
 
@@ -0,0 +1,192 @@
+/*************************************************************************/
+/* The long-range repeat model.                                          */
+/*                                                                       */
+/* Disk images and database dumps repeat multi-kilobyte regions far      */
+/* further apart than the deterministic model's window reaches, and far  */
+/* enough apart that the Trie has long since recycled the Contexts which */
+/* saw them the first time.  We catch those by indexing a sample of      */
+/* positions over the entire input to date.                              */
+/*                                                                       */
+/* We keep a rolling hash of the REPEAT_HASH_LEN bytes before the        */
+/* current position.  Positions whose hash has its top                   */
+/* REPEAT_SAMPLE_BITS bits clear -- about one in 32, chosen by content,  */
+/* so both copies of a repeat pick the same spots -- go into 'index',    */
+/* keyed by the rest of the hash.  When a sampled position finds an      */
+/* earlier one under its key, and the history before the two really      */
+/* does agree for at least REPEAT_MIN_LEN bytes, we adopt the earlier    */
+/* one as our 'match' and from then on predict whatever followed it,     */
+/* until a prediction fails.                                             */
+/*                                                                       */
+/* pzip.c offers us each symbol the deterministic model declines, and    */
+/* like it we code just "hit" or "escape", via a det_escape.c Escape     */
+/* of our own keyed by how long the match has held.  On a hit the PPM    */
+/* Contexts are left alone, exactly as for a deterministic hit.          */
+/*************************************************************************/
+
+#include "repeat.h"
+#include "det_escape.h"
+#include "huge.h"
+
+#define REPEAT_HASH_LEN      (32)       /* Must not exceed PZIP_MAX_CONTEXT_LEN. */
+#define REPEAT_MIN_LEN       (32)       /* Shortest history we will trust.       */
+#define REPEAT_VERIFY_LEN   (255)       /* Longest we bother measuring at first. */
+
+#define REPEAT_SAMPLE_BITS    (5)
+#define REPEAT_INDEX_BITS    (22)       /* 4M sampled positions in 16MB.         */
+#define REPEAT_INDEX_SIZE    (1 << REPEAT_INDEX_BITS)
+
+#define HASH_BASE   (0x01000193)        /* Of the polynomial rolling hash.       */
+#define HASH_MIX    (0x9E3779B1)        /* Spreads it into the top bits.         */
+
+struct Repeat {
+    Escape* escape;
+    u32*    index;          /* Latest sampled position by hash, 0 if none.          */
+
+    u32     position;       /* 'hash' covers the REPEAT_HASH_LEN bytes before this. */
+    u32     hash;
+    u32     base_to_len;    /* HASH_BASE ** REPEAT_HASH_LEN, to roll bytes out.     */
+
+    u32     match;          /* Position whose byte we predict next, 0 if none.      */
+    u32     match_len;      /* How far back the history agrees with it.             */
+};
+
+Repeat* repeat_Create( void ) {
+
+    Repeat* self = new( Repeat );
+
+    self->escape = escape_Create();
+    self->index  = huge_Calloc( sizeof( u32 ) * REPEAT_INDEX_SIZE );
+
+    {   int i;
+        self->base_to_len = 1;
+        for (i = 0;   i < REPEAT_HASH_LEN;   ++i)   self->base_to_len *= HASH_BASE;
+    }
+
+    repeat_Reset( self );
+
+    return self;
+}
+
+void repeat_Destroy( Repeat* self ) {
+
+    if (!self)   return;
+
+    escape_Destroy( self->escape );
+    huge_Free(      self->index  );
+    destroy(        self         );
+}
+
+void repeat_Reset( Repeat* self ) {
+
+    /* A decoder reusing us must see exactly what */
+    /* a fresh one would, so forget every entry:  */
+    memset( self->index, 0, sizeof( u32 ) * REPEAT_INDEX_SIZE );
+    escape_Reset( self->escape );
+
+    self->position  = 0;
+    self->hash      = 0;
+    self->match     = 0;
+    self->match_len = 0;
+}
+
+static u32 hash_before(   u08* p   ) {
+    u32 hash = 0;
+    int i;
+    for (i = REPEAT_HASH_LEN;   i;   --i)   hash = hash * HASH_BASE + p[ -i ];
+    return hash;
+}
+
+static void try_match(   Repeat* self,   u32 candidate,   u32 position,   u08* input_buf   ) {
+
+    /* Hashes collide, so check that the histories */
+    /* really agree, and measure how far back:     */
+    u08* p       = input_buf + position;
+    u08* q       = input_buf + candidate;
+    uint max_len = min( candidate, REPEAT_VERIFY_LEN );
+    uint len     = 0;
+
+    while (len < max_len && p[ -1 - (int)len ] == q[ -1 - (int)len ])   ++len;
+
+    if (len >= REPEAT_MIN_LEN) {
+        self->match     = candidate;
+        self->match_len = len;
+    }
+}
+
+void repeat_Update(   Repeat* self,   u08* input_ptr,   u08* input_buf,   int symbol   ) {
+
+    /* We get called on each char in the file in */
+    /* succession, with it already at *input_ptr. */
+
+    u32 position = input_ptr - input_buf;
+
+    /* Follow our match, or drop it: */
+    if (self->match) {
+        if (input_buf[ self->match ] == symbol) {
+            ++ self->match;
+            ++ self->match_len;
+        } else {
+            self->match = 0;
+        }
+    }
+
+    /* Roll 'symbol' in: */
+    if (self->position != position)   self->hash = hash_before( input_ptr );   /* Our first call. */
+    self->hash     = self->hash * HASH_BASE + symbol - input_ptr[ -REPEAT_HASH_LEN ] * self->base_to_len;
+    self->position = ++ position;
+
+    {   u32 mixed = self->hash * HASH_MIX;
+
+        if (mixed >> (32 - REPEAT_SAMPLE_BITS) == 0) {
+
+            u32* slot = &self->index[ (mixed >> (32 - REPEAT_SAMPLE_BITS - REPEAT_INDEX_BITS)) & (REPEAT_INDEX_SIZE -1) ];
+
+            if (!self->match && *slot)   try_match( self, *slot, position, input_buf );
+
+            *slot = position;
+        }
+    }
+}
+
+static inline int confidence(   Repeat* self   ) {
+    /* Total count for the Escape:  Grows */
+    /* with match length, from 1 to 14:   */
+    return min( self->match_len >> 5, 14 );
+}
+
+bool repeat_Encode(   Repeat* self,   Arith* arith,   u08* input_ptr,   u08* input_buf,   int symbol,   Excluded_Symbols* excl   ) {
+
+    if (!self->match)   return FALSE;
+
+    {   int  prediction = input_buf[ self->match ];
+        bool match      = (symbol == prediction);
+
+        /* The deterministic model already tried and failed: */
+        if (excluded_symbols_Contains( excl, prediction ))   return FALSE;
+
+        escape_Encode( self->escape, arith, getu32( input_ptr -4 ), 1, confidence( self ), !excluded_symbols_Is_Empty( excl ), !match );
+
+        excluded_symbols_Add( excl, prediction );
+
+        return match;
+    }
+}
+
+bool repeat_Decode(   Repeat* self,   Arith* arith,   u08* input_ptr,   u08* input_buf,   int* psymbol,   Excluded_Symbols* excl   ) {
+
+    if (!self->match)   return FALSE;
+
+    {   int  symbol = input_buf[ self->match ];
+
+        if (excluded_symbols_Contains( excl, symbol ))   return FALSE;
+
+        {   bool match = ! escape_Decode( self->escape, arith, getu32( input_ptr -4 ), 1, confidence( self ), !excluded_symbols_Is_Empty( excl ) );
+
+            excluded_symbols_Add( excl, symbol );
+
+            *psymbol = symbol;
+
+            return match;
+        }
+    }
+}
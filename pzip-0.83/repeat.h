@@ -0,0 +1,21 @@
+#ifndef REPEAT_H
+#define REPEAT_H
+
+#include "inc.h"
+#include "arithmetic-encoding.h"
+#include "excluded_symbols.h"
+
+/* The long-range repeat model, enabled by  */
+/* PZIP_OPTION_LONG_REPEATS.  See repeat.c. */
+
+typedef struct Repeat Repeat;
+
+Repeat* repeat_Create(  void           );
+void    repeat_Destroy( Repeat* self   );
+void    repeat_Reset(   Repeat* self   );
+
+void    repeat_Update(  Repeat* self,                   u08* input_ptr,   u08* input_buf,   int   symbol                              );
+bool    repeat_Encode(  Repeat* self,   Arith* arith,   u08* input_ptr,   u08* input_buf,   int   symbol,   Excluded_Symbols* excl   );
+bool    repeat_Decode(  Repeat* self,   Arith* arith,   u08* input_ptr,   u08* input_buf,   int* psymbol,   Excluded_Symbols* excl   );
+
+#endif /* REPEAT_H */
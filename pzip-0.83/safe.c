@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* Trivial wrappers to save us from having to */
 /* litter the code with tests for NULL every- */
@@ -19,5 +20,14 @@ void* safe_Calloc( size_t nmemb, size_t size ) {
     exit(1);
 }
 
+void* safe_Aligned_Calloc( size_t alignment, size_t size ) {
+    void* result;
+    if (!posix_memalign( &result, alignment, size )) {
+        memset( result, 0, size );
+        return result;
+    }
+    fputs( "Out of memory!", stderr );
+    exit(1);
+}
 
     
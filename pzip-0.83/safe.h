@@ -5,5 +5,6 @@
 
 void* safe_Malloc( size_t size );
 void* safe_Calloc( size_t nmemb, size_t size );
+void* safe_Aligned_Calloc( size_t alignment, size_t size );   /* Release with free(). */
 
 #endif /* SAFE_H */
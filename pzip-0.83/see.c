@@ -13,6 +13,7 @@
 #include "context.h"
 
 #include "intmath.h"
+#include "huge.h"
 
 // The hash is:
 // top  5 bits are esc/tot
@@ -29,20 +30,82 @@
 #define ORDER1_SIZE (1 << ORDER1_BITS)
 #define ORDER2_SIZE (1 << ORDER2_BITS)
 
+/* see_Reset() need only clear those chunks (pages) */
+/* of order2 which see_Adjust_State() has touched:  */
+#define ORDER2_CHUNK_BITS (10)
+#define ORDER2_CHUNKS     (ORDER2_SIZE >> ORDER2_CHUNK_BITS)
+
 #define MAX_SEE_ESCC    ( 3)
 #define MAX_SEE_TOTC    (64)
 
+/*****************************************************************/
+/* Each See_State starts out with seed counts which depend only  */
+/* on the esc/tot bucket it is in, i.e. the top five bits of its */
+/* index.  We store its counts less those seeds, so a state no   */
+/* one has adjusted yet is all zero bits:  The tables need no    */
+/* initializing, and the 32MB order2 table stays in untouched    */
+/* zero pages until states actually get used.  'seen' records    */
+/* whether the state has ever been adjusted.                     */
+/*                                                               */
+/* Counts stay below SEE_SCALE_DOWN (8000), and seeds are small, */
+/* so the differences fit easily in 15 bits.                     */
+/*                                                               */
+/* Parents are implicit in the index:  order2[ i ] rolls up into */
+/* order1[ i >> 7 ], which rolls up into order0[ i >> 14 ].      */
+/*****************************************************************/
+
 struct See_State {
-    See_State* parent;
-    uint       seen;
-    uint       escapes;
-    uint       total;
+    signed   int escapes : 16;
+    signed   int total   : 15;
+    unsigned int seen    :  1;
 };
 
+typedef char see_state_size_check[ sizeof( See_State ) == 4   ?   1   :   -1 ];
+
+/* Local ephemeral type for actual counts: */
+typedef struct {
+    uint escapes;
+    uint total;
+} X;
+
+/*****************************************************************/
+/* Coding one symbol may ask several times about one Context:    */
+/* choose_context() rates each candidate, the one picked asks    */
+/* again to code its escape, and candidates which an escape's    */
+/* exclusions did not change get rated again.  So we remember,   */
+/* per order, the last see_Get_State() answer and the get_stats() */
+/* blend for it.                                                 */
+/*                                                               */
+/* An answer holds until see_Forget(), because the followset     */
+/* sizes which went into the hash may have changed.  A blend     */
+/* holds until see_Adjust_State() touches its order0 state or    */
+/* one of that state's children, which 'generation' counts.      */
+/*****************************************************************/
+
+typedef struct {
+    const Context* context;
+    u32            key;
+    uint           escape_count;
+    uint           total_symbol_count;
+    uint           epoch;                   /* Answer valid iff == see->epoch.         */
+    See_State*     ss;
+    uint           generation;              /* Blend valid iff == see->generation[ i0 ]. */
+    X              x;                       /* get_stats( ss, ... ) blend.             */
+} Memo;
+
 struct See {
     See_State order0[ ORDER0_SIZE ];
     See_State order1[ ORDER1_SIZE ];
     See_State order2[ ORDER2_SIZE ];
+
+    X         seed[ 32 ];                   /* By esc/tot bucket: Top five index bits.     */
+    u32       dirty[ ORDER2_CHUNKS / 32 ];  /* Bit set iff chunk of order2 may be non-zero. */
+
+    u32       generation[ ORDER0_SIZE ];    /* Bumped by adjustments below each order0 state. */
+
+    Memo      memo[ PZIP_ORDER +1 ];        /* By Context order.                              */
+    Memo*     last;                         /* Slot of the latest see_Get_State() answer.     */
+    uint      epoch;
 };
 
 static uint tottab[] = {
@@ -56,6 +119,19 @@ static uint tottab[] = {
    20,    /* 7 */ 
 };
 
+#define order0_index( see, ss )   ((uint)((ss) - (see)->order2) >> (ORDER2_BITS - ORDER0_BITS))
+
+static void forget_all( See* see ) {
+    memset( see->generation, 0, sizeof( see->generation ) );
+    memset( see->memo,       0, sizeof( see->memo       ) );
+    see->last  = &see->memo[ 0 ];
+    see->epoch = 1;
+}
+
+void see_Forget( See* see ) {
+    if (!++see->epoch)   forget_all( see );
+}
+
 static See* initialize( See* see ) {
 
     uint e;
@@ -71,58 +147,83 @@ static See* initialize( See* see ) {
 
             /* The five bit esc/tot: */
             uint h_hi        = (e << 3) + t;
-            uint seed_escape = escape_count * SEE_INIT_SCALE + SEE_INIT_ESC;
-            uint seed_total  = (escape_count + total_symbol_count) * SEE_INIT_SCALE + SEE_INIT_TOT;
-            uint shift       = ORDER1_BITS - 5;
 
-            uint h_lo;
-            for (h_lo = 0;   h_lo < ((uint)1 << shift);   ++h_lo) {
+            see->seed[ h_hi ].escapes = escape_count * SEE_INIT_SCALE + SEE_INIT_ESC;
+            see->seed[ h_hi ].total   = (escape_count + total_symbol_count) * SEE_INIT_SCALE + SEE_INIT_TOT;
+        }
+    }
+
+    forget_all( see );
 
-                uint hash = (h_hi << shift) | h_lo;                    assert( hash < ORDER1_SIZE );
+    return see;
+}
 
-                {   See_State* ss = &see->order1[ hash ];
+See* see_Create( void )      {   return initialize( huge_Calloc( sizeof( See ) ) );   }
+void see_Destroy( See* see ) {   huge_Free( see );                                    }
 
-                    ss->escapes  = seed_escape;
-                    ss->total    = seed_total;
-                    ss->parent   = &see->order0[ hash >> (ORDER1_BITS - ORDER0_BITS) ];
+void see_Reset( See* see ) {
 
-                    ss           = ss->parent;
-                    ss->escapes  = seed_escape;
-                    ss->total    = seed_total;
-                }
-            }
+    /* Back to all zeros, as see_Create() left us,  */
+    /* without touching the (typically many) pages  */
+    /* which still are.  Only see_Adjust_State()    */
+    /* writes order1 and order0, and only the       */
+    /* parents of the order2 state it marks dirty,  */
+    /* so a dirty chunk also names what to clear of */
+    /* those:                                       */
+
+    uint w;
+
+    for (w = 0;   w < ORDER2_CHUNKS / 32;   ++w) {
+
+        u32 bits = see->dirty[ w ];
+
+        while (bits) {
+            uint chunk = (w << 5) + __builtin_ctz( bits );
+            uint i2    = chunk << ORDER2_CHUNK_BITS;
+            memset( &see->order2[ i2 ], 0, sizeof( See_State ) << ORDER2_CHUNK_BITS );
+            memset( &see->order1[ i2 >> (ORDER2_BITS - ORDER1_BITS) ], 0, sizeof( See_State ) << (ORDER2_CHUNK_BITS - (ORDER2_BITS - ORDER1_BITS)) );
+            memset( &see->order0[ i2 >> (ORDER2_BITS - ORDER0_BITS) ], 0, sizeof( See_State ) );
+            bits &= bits -1;
         }
+        see->dirty[ w ] = 0;
     }
 
-    return see;
+    forget_all( see );
 }
 
-See* see_Create( void )      {   return initialize( calloc( 1, sizeof( See ) ) );   }
-void see_Destroy( See* see ) {   destroy( see );                                    }
-
 /* Define a local synonym for readability: */
 #undef  log2
 #define log2 ilog2roundtab
 
 
-/* Local ephemeral return type: */
-typedef struct {
-    uint escapes;
-    uint total;
-} X;
+static inline X counts(   See* see,   See_State* ss,   uint index,   int bits   ) {
+    X seed = see->seed[ index >> (bits - 5) ];
+    X x;
+    x.escapes = seed.escapes + ss->escapes;
+    x.total   = seed.total   + ss->total;
+    return x;
+}
 
 static X get_stats(   See* see,   See_State* ss2,   uint inEsc,   uint inTot   ) {
 
-    See_State* ss1 = ss2->parent;
-    See_State* ss0 = ss1->parent;
+    uint i2 = ss2 - see->order2;
+    uint i1 = i2 >> (ORDER2_BITS - ORDER1_BITS);
+    uint i0 = i1 >> (ORDER1_BITS - ORDER0_BITS);
 
-    uint e0 = ss0->escapes;   uint t0 = ss0->total;   uint s0 = ss0->seen;
-    uint e1 = ss1->escapes;   uint t1 = ss1->total;   uint s1 = ss1->seen;   
-    uint e2 = ss2->escapes;   uint t2 = ss2->total;   uint s2 = ss2->seen;
+    See_State* ss1 = &see->order1[ i1 ];
+    See_State* ss0 = &see->order0[ i0 ];
 
-    uint w0 = (1 << 16) / (t0 * log2(t0) - e0 * log2(e0) - (t0-e0) * log2(t0-e0) + 1);
-    uint w1 = (1 << 16) / (t1 * log2(t1) - e1 * log2(e1) - (t1-e1) * log2(t1-e1) + 1);
-    uint w2 = (1 << 16) / (t2 * log2(t2) - e2 * log2(e2) - (t2-e2) * log2(t2-e2) + 1);
+    X c0 = counts( see, ss0, i0, ORDER0_BITS );
+    X c1 = counts( see, ss1, i1, ORDER1_BITS );
+    X c2 = counts( see, ss2, i2, ORDER2_BITS );
+
+    uint e0 = c0.escapes;   uint t0 = c0.total;   uint s0 = ss0->seen;
+    uint e1 = c1.escapes;   uint t1 = c1.total;   uint s1 = ss1->seen;
+    uint e2 = c2.escapes;   uint t2 = c2.total;   uint s2 = ss2->seen;
+
+    uint w0 = intdiv( 1 << 16, t0 * log2(t0) - e0 * log2(e0) - (t0-e0) * log2(t0-e0) + 1 );
+    uint w1 = intdiv( 1 << 16, t1 * log2(t1) - e1 * log2(e1) - (t1-e1) * log2(t1-e1) + 1 );
+    uint w2 = intdiv( 1 << 16, t2 * log2(t2) - e2 * log2(e2) - (t2-e2) * log2(t2-e2) + 1 );
 
     /* Give less weight to contexts with only the default stats. */
     /* This helps a bit; *2,3, or 4 seems the best multiple:     */
@@ -136,7 +237,7 @@ static X get_stats(   See* see,   See_State* ss2,   uint inEsc,   uint inTot   )
 
             uint ei = inEsc;
             uint ti = inTot;
-            uint wi = (1 << 16) / (ti * log2(ti) - ei * log2(ei) - (ti-ei) * log2(ti-ei) + 1);
+            uint wi = intdiv( 1 << 16, ti * log2(ti) - ei * log2(ei) - (ti-ei) * log2(ti-ei) + 1 );
 
             /**************************************************************/
             /* Blend by entropy the predictions of our different models.  */
@@ -164,10 +265,12 @@ static X get_stats(   See* see,   See_State* ss2,   uint inEsc,   uint inTot   )
             x.escapes = w0*e0 + w1*e1 + w2*e2 + wi*ei;
         }
 
-        /* Renormalize to avoid overflow in the arithmetic encoder: */
-        while (x.total >= 16000) {
-            x.total   >>= 1;
-            x.escapes >>= 1;
+        /* Renormalize to avoid overflow in the arithmetic encoder:  */
+        /* Halve until x.total < 16000, done as one or two shifts.   */
+        {   int shift = intshift_below( x.total, 14 );
+            shift    += (x.total >> shift) >= 16000;
+            x.total   >>= shift;
+            x.escapes >>= shift;
         }
 
         /* If our prediction is insane -- change it! :) */
@@ -184,12 +287,30 @@ static X get_stats(   See* see,   See_State* ss2,   uint inEsc,   uint inTot   )
 
 #undef  log2
 
+static inline X memo_stats(   See* see,   See_State* ss,   uint escape_count,   uint total_symbol_count   ) {
+
+    /* Usually 'ss' is what see_Get_State() just returned: */
+    Memo* m = see->last;
+    u32   g;
+    if (m->ss                 != ss
+    ||  m->escape_count       != escape_count
+    ||  m->total_symbol_count != total_symbol_count
+    ){
+        return get_stats(   see,   ss,   escape_count,   escape_count + total_symbol_count   );
+    }
+    g = see->generation[ order0_index( see, ss ) ];
+    if (m->generation != g) {
+        m->x          = get_stats(   see,   ss,   escape_count,   escape_count + total_symbol_count   );
+        m->generation = g;
+    }
+    return m->x;
+}
 
 void  see_Encode_Escape(   See* see,   Arith* arith,   See_State* ss,   uint escape_count,   uint total_symbol_count,   bool escape   ) {
     if (!ss) {
         arith_Encode_Bit(   arith,   total_symbol_count,   escape_count + total_symbol_count,   escape   );
     } else {
-        X x = get_stats(   see,   ss,   escape_count,   escape_count + total_symbol_count   );
+        X x = memo_stats(   see,   ss,   escape_count,   total_symbol_count   );
         arith_Encode_Bit( arith, x.escapes, x.total, !escape );
         see_Adjust_State( see, ss, escape );
     }
@@ -199,7 +320,7 @@ bool see_Decode_Escape(   See* see,   Arith* arith,   See_State* ss,   uint esca
     if (!ss) {
         return arith_Decode_Bit(   arith,   total_symbol_count,   escape_count + total_symbol_count   );
     } else {
-        X    x      = get_stats(   see,   ss,   escape_count,   escape_count + total_symbol_count   );
+        X    x      = memo_stats(   see,   ss,   escape_count,   total_symbol_count   );
         bool escape = arith_Decode_Bit( arith, x.escapes, x.total );
         see_Adjust_State( see, ss, !escape );
         return !escape;
@@ -208,60 +329,60 @@ bool see_Decode_Escape(   See* see,   Arith* arith,   See_State* ss,   uint esca
 
 uint see_Estimate_Escape_Probability(   See* see,   See_State* ss,   uint escape_count,   uint total_symbol_count ) {
     if (ss) {
-        X x = get_stats(   see,   ss,   escape_count,   escape_count + total_symbol_count   );
-        return   (x.escapes << PZIP_INTPROB_SHIFT) / x.total;
+        X x = memo_stats(   see,   ss,   escape_count,   total_symbol_count   );
+        return   intdiv( x.escapes << PZIP_INTPROB_SHIFT, x.total );
     }
-    return   (escape_count << PZIP_INTPROB_SHIFT) / (escape_count + total_symbol_count);
+    return   intdiv( escape_count << PZIP_INTPROB_SHIFT, escape_count + total_symbol_count );
 }
 
-void see_Adjust_State(   See* see,   See_State* ss,   bool escape   ) {
+static void adjust(   See* see,   See_State* ss,   uint index,   int bits,   bool escape   ) {
 
-    for (;   ss;   ss = ss->parent) {
-        
-        ++ ss->seen;
+    X    seed    = see->seed[ index >> (bits - 5) ];
+    uint escapes = seed.escapes + ss->escapes;
+    uint total   = seed.total   + ss->total;
 
-        if (escape) {
+    if (escape) {
 
-            ss->escapes += SEE_INC;
-            ss->total   += SEE_INC + SEE_ESC_TOT_EXTRA_INC;
+        escapes += SEE_INC;
+        total   += SEE_INC + SEE_ESC_TOT_EXTRA_INC;
 
-        } else {
+    } else {
 
-            /* Forget escapes quickly: */
-            if (ss->escapes >= SEE_ESC_SCALE_DOWN) {
-                ss->escapes  = (ss->escapes >> 1) + 1;
-                ss->total    = (ss->total   >> 1) + 2;
-            }
-            ss->total += SEE_INC;
+        /* Forget escapes quickly: */
+        if (escapes >= SEE_ESC_SCALE_DOWN) {
+            escapes  = (escapes >> 1) + 1;
+            total    = (total   >> 1) + 2;
         }
+        total += SEE_INC;
+    }
 
-        if (ss->total >= SEE_SCALE_DOWN) {
-            ss->escapes = (ss->escapes >> 1) + 1;
-            ss->total = (ss->total >> 1) + 2;
-            assert( ss->total < SEE_SCALE_DOWN );
-        }
+    if (total >= SEE_SCALE_DOWN) {
+        escapes = (escapes >> 1) + 1;
+        total   = (total   >> 1) + 2;
+        assert( total < SEE_SCALE_DOWN );
     }
-}
 
+    ss->seen    = 1;
+    ss->escapes = (int)escapes - (int)seed.escapes;
+    ss->total   = (int)total   - (int)seed.total;
+}
 
-static void stats_from_hash(   See_State* ss,   uint five_bits   ) {
+void see_Adjust_State(   See* see,   See_State* ss,   bool escape   ) {
 
-    uint e = five_bits >> 3;
-    uint t = five_bits  & 7;
+    uint i2 = ss - see->order2;
+    uint i1 = i2 >> (ORDER2_BITS - ORDER1_BITS);
+    uint i0 = i1 >> (ORDER1_BITS - ORDER0_BITS);
 
-    uint total        = tottab[ t ];
-    uint escape_count = e + 1;
+    see->dirty[ i2 >> (ORDER2_CHUNK_BITS + 5) ] |= 1u << ((i2 >> ORDER2_CHUNK_BITS) & 31);
 
-    uint total_symbol_count = total + escape_count;
+    ++see->generation[ i0 ];
 
-    uint seed_escape = escape_count * SEE_INIT_SCALE + SEE_INIT_ESC;
-    uint seed_total  = (escape_count + total_symbol_count) * SEE_INIT_SCALE + SEE_INIT_TOT;
-        
-    ss->escapes = seed_escape;
-    ss->total   = seed_total;
+    adjust( see, ss,                 i2, ORDER2_BITS, escape );
+    adjust( see, &see->order1[ i1 ], i1, ORDER1_BITS, escape );
+    adjust( see, &see->order0[ i0 ], i0, ORDER0_BITS, escape );
 }
 
-See_State* see_Get_State(   See* see,   uint escape_count,   uint total_symbol_count,   u32 key,   const Context* context   ) {
+static See_State* get_state(   See* see,   uint escape_count,   uint total_symbol_count,   u32 key,   const Context* context   ) {
 
     // Do the hash;
     //      order
@@ -364,18 +485,33 @@ See_State* see_Get_State(   See* see,   uint escape_count,   uint total_symbol_c
         hash2 <<= 5;
         hash2 |= key & 31;        assert( hash2 < ORDER2_SIZE );
 
-        {   uint hash1 = hash2 >> (ORDER2_BITS - ORDER1_BITS);
-            See_State* ss1 = &see->order1[ hash1 ];
-            See_State* ss2 = &see->order2[ hash2 ];
-
-            if (!ss2->parent) {
-
-                ss2->parent = ss1;
-                stats_from_hash( ss2, hash2 >> (ORDER2_BITS - 5) );
-            }
-            return ss2;
-        }
+        /* Untouched states read as their seeds, */
+        /* so there is nothing to initialize:    */
+        return &see->order2[ hash2 ];
     }
 }
 
 
+
+See_State* see_Get_State(   See* see,   uint escape_count,   uint total_symbol_count,   u32 key,   const Context* context   ) {
+
+    Memo* m = &see->memo[ context->order ];
+
+    if (m->epoch              != see->epoch
+    ||  m->context            != context
+    ||  m->key                != key
+    ||  m->escape_count       != escape_count
+    ||  m->total_symbol_count != total_symbol_count
+    ){
+        m->context            = context;
+        m->key                = key;
+        m->escape_count       = escape_count;
+        m->total_symbol_count = total_symbol_count;
+        m->epoch              = see->epoch;
+        m->ss                 = get_state( see, escape_count, total_symbol_count, key, context );
+        if (m->ss)   m->generation = see->generation[ order0_index( see, m->ss ) ] -1;   /* No blend yet. */
+    }
+
+    see->last = m;
+    return m->ss;
+}
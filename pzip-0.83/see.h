@@ -14,6 +14,8 @@ typedef struct See See;
 
 See* see_Create(  void     );
 void see_Destroy( See* see );
+void see_Reset(   See* see );
+void see_Forget(  See* see );   /* Context followset sizes (may) have changed. */
 
 See_State* see_Get_State(     See* see,   uint escape_count,   uint tot_symbol_count,   u32 key,   const Context* context  );
 void       see_Encode_Escape( See* see,   Arith* arith,   See_State* ss,   uint escape_count,   uint tot_symbol_count,   bool escape   );